@@ -5,7 +5,8 @@
 #include <unordered_set>
 #include <vector>
 
-#include "bc.hpp"
+// Angle brackets, so that headless builds pick up sim/bc.hpp instead.
+#include <bc.hpp>
 
 // FIXME: Copied from PairwiseDistances.hpp.
 std::vector<std::pair<int, int>> make_kernel(int min_distance_squared,
@@ -35,6 +36,9 @@ constexpr static int N_DIRECTIONS_WITHOUT_CENTER = N_DIRECTIONS - 1;
 constexpr static array<int, N_DIRECTIONS> DX = {0, 1, 1, 1, 0, -1, -1, -1, 0};
 constexpr static array<int, N_DIRECTIONS> DY = {1, 1, 0, -1, -1, -1, 0, 1, 0};
 
+// Heat. Units can only act while their heat is below this.
+constexpr static unsigned MAX_HEAT = 10;
+
 // Costs.
 const static array<unsigned, N_UNIT_TYPES> BLUEPRINT_COST = {
     numeric_limits<unsigned>::max(),  // Worker
@@ -126,6 +130,9 @@ const static vector<pair<int, int>> KERNEL[N_UNIT_TYPES] = {
     POINT_KERNEL,         // Rocket
 };
 
+// Rangers can't attack this close, or closer.
+constexpr static unsigned RANGER_CANNOT_ATTACK_RANGE = 10;
+
 // Attack ranges.
 const static array<unsigned, N_UNIT_TYPES> ATTACK_RANGE = {
     0,   // Worker
@@ -136,6 +143,16 @@ const static array<unsigned, N_UNIT_TYPES> ATTACK_RANGE = {
     0,   // Factory
     0,   // Rocket
 };
+// Damage of an attack, from the specs. Healers heal instead.
+const static array<unsigned, N_UNIT_TYPES> ATTACK_DAMAGE = {
+    0,   // Worker
+    60,  // Knight
+    40,  // Ranger
+    60,  // Mage
+    0,   // Healer
+    0,   // Factory
+    0,   // Rocket
+};
 const static array<unsigned, N_UNIT_TYPES> SPECIAL_ATTACK_RANGE = {
     0,     // Worker
     10,    // Knight
@@ -145,5 +162,15 @@ const static array<unsigned, N_UNIT_TYPES> SPECIAL_ATTACK_RANGE = {
     0,     // Factory
     0,     // Rocket
 };
+// Vision ranges, from the specs, before research.
+const static array<unsigned, N_UNIT_TYPES> VISION_RANGE = {
+    50,  // Worker
+    50,  // Knight
+    70,  // Ranger
+    30,  // Mage
+    50,  // Healer
+    2,   // Factory
+    2,   // Rocket
+};
 
 }  // namespace constants
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "GameState.hpp"
+#include "PairwiseDistances.hpp"
+#include "TargetSearch.hpp"
+#include "bc.hpp"
+
+using namespace bc;
+using namespace std;
+
+struct AssignmentTarget {
+  uint8_t x;
+  uint8_t y;
+
+  // Cost of a unit going there is `weight` times its distance.
+  float weight;
+
+  // Units that can go there.
+  int capacity;
+
+  // Units further than this cost can't go there.
+  float max_cost;
+
+  AssignmentTarget(const Coord &loc, float weight, int capacity,
+                   float max_cost = numeric_limits<float>::infinity())
+      : x(loc.get_x()),
+        y(loc.get_y()),
+        weight(weight),
+        capacity(capacity),
+        max_cost(max_cost) {}
+};
+
+// Sends units to targets, at most `capacity` of them to each, assigning as
+// many units as possible at the least total cost. Unreachable targets are
+// never assigned. Returns one Target per assigned unit, cheapest first.
+//
+// Only the few cheapest targets of each unit are considered, which keeps
+// memory linear in the number of units and targets, and the assignment is
+// optimal over those. Units that get none of theirs take the cheapest target
+// left over, if any.
+vector<Target> assign_targets(GameState &game_state,
+                              const vector<unsigned> &units,
+                              const vector<AssignmentTarget> &targets,
+                              const PairwiseDistances &distances);
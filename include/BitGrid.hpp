@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "constants.hpp"
+
+using namespace std;
+
+// One bit per cell, a word per row: bit y + 1 of row x is cell (x, y). Rows
+// -1 and `width` and bits 0 and `height + 1` are a border that is always
+// clear, so neighbourhood queries need no bounds checks, and a query over a
+// square of cells is a few masked words per row.
+struct BitGrid {
+  static_assert(constants::MAX_MAP_SIZE + 2 <= 64,
+                "A padded row must fit in a word.");
+
+  int width;
+  int height;
+
+  BitGrid(int width, int height);
+
+  inline bool test(int x, int y) const { return rows[x + 1] >> (y + 1) & 1; }
+  inline void set(int x, int y) { rows[x + 1] |= 1ull << (y + 1); }
+  inline void reset(int x, int y) { rows[x + 1] &= ~(1ull << (y + 1)); }
+  inline void assign(int x, int y, bool value) {
+    if (value) {
+      set(x, y);
+    } else {
+      reset(x, y);
+    }
+  }
+  void clear();
+
+  // Sets the cells of row x in [y - radius, y + radius] that are on the map.
+  inline void set_span(int x, int y, int radius) {
+    if (x < 0 || x >= width) return;
+    rows[x + 1] |= span(y, radius) & inside;
+  }
+
+  // Row x, for x in [-1, width], including its border bits.
+  inline uint64_t row(int x) const { return rows[x + 1]; }
+
+  // Bits of the cells of a row in [y - radius, y + radius], in the border
+  // too.
+  static inline uint64_t span(int y, int radius) {
+    const int lo = y + 1 - radius < 0 ? 0 : y + 1 - radius;
+    const int hi = y + 1 + radius > 63 ? 63 : y + 1 + radius;
+    const uint64_t ones = hi - lo == 63 ? ~0ull : (1ull << (hi - lo + 1)) - 1;
+    return ones << lo;
+  }
+
+  // Set cells among the 8 neighbours of (x, y).
+  int count_neighbours(int x, int y) const;
+
+  // Whether a cell within `radius` steps of (x, y) is set, (x, y) included.
+  bool any_within(int x, int y, int radius) const;
+
+ private:
+  vector<uint64_t> rows;
+  // Bits of the cells of a row, without the border.
+  uint64_t inside;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include "bc.hpp"
+#include "constants.hpp"
+
+using namespace bc;
+
+// A cell of a planet. MapLocation allocates on the engine side whenever it is
+// built or copied, this is three bytes that copy for free, so it is what the
+// bot passes around. MapInfo::get_map_location turns one into a MapLocation
+// for the API calls without allocating. Off the map cells are allowed, like
+// with MapLocation::add.
+struct Coord {
+  uint8_t planet;
+  int8_t x;
+  int8_t y;
+
+  Coord() = default;
+  Coord(Planet planet, int x, int y)
+      : planet(static_cast<uint8_t>(planet)),
+        x(static_cast<int8_t>(x)),
+        y(static_cast<int8_t>(y)) {}
+  explicit Coord(const MapLocation& loc)
+      : Coord(loc.get_planet(), loc.get_x(), loc.get_y()) {}
+
+  inline Planet get_planet() const { return static_cast<Planet>(planet); }
+  inline int get_x() const { return x; }
+  inline int get_y() const { return y; }
+
+  inline Coord add(Direction dir) const {
+    return Coord(get_planet(), x + constants::DX[dir], y + constants::DY[dir]);
+  }
+
+  inline bool operator==(const Coord& other) const {
+    return planet == other.planet && x == other.x && y == other.y;
+  }
+  inline bool operator!=(const Coord& other) const { return !(*this == other); }
+
+  // Allocates, only for cells of the other planet, which have no pool.
+  inline MapLocation to_map_location() const {
+    return MapLocation(get_planet(), x, y);
+  }
+};
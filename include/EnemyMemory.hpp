@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include "BitGrid.hpp"
+#include "UnitList.hpp"
+#include "bc.hpp"
+
+using namespace std;
+using namespace bc;
+
+// Enemies as last seen on the map, remembered after they leave vision.
+struct EnemyMemory {
+  // Sightings older than this many rounds are forgotten.
+  constexpr static uint32_t MAX_AGE = 50;
+
+  struct Sighting {
+    UnitType unit_type;
+    uint8_t x;
+    uint8_t y;
+    unsigned health;
+    uint32_t round;
+  };
+
+  uint32_t round = 0;
+  unordered_map<unsigned, Sighting> sightings;
+
+  // Records the enemies sensed this round in `enemies`, and forgets the ones
+  // whose cell is sensed without them or that were seen too long ago. Costs
+  // a step per sensed or remembered enemy, not per cell.
+  void update(uint32_t current_round, const UnitList &enemies,
+              const BitGrid &can_sense);
+
+  // Forgets an enemy known to be dead.
+  inline void forget(unsigned id) { sightings.erase(id); }
+
+  inline bool is_visible(const Sighting &sighting) const {
+    return sighting.round == round;
+  }
+  inline uint32_t get_age(const Sighting &sighting) const {
+    return round - sighting.round;
+  }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "MapInfo.hpp"
+#include "PairwiseDistances.hpp"
+#include "bc.hpp"
+
+using namespace std;
+using namespace bc;
+
+// Up to 8 directions packed in a word, 4 bits each after a 4 bit count.
+struct MoveList {
+  uint64_t bits;
+
+  inline int size() const { return bits & 0xf; }
+  inline Direction operator[](int i) const {
+    return static_cast<Direction>(bits >> (4 + 4 * i) & 0xf);
+  }
+};
+
+// Moves towards each goal, shared by every unit heading there this turn.
+// The moves of a cell are computed the first time a unit asks for them.
+struct FlowFields {
+  // Moves from (x, y) that don't lead away from the goal under `pd`, best
+  // first. Moves that keep the distance come last and only when not at the
+  // goal yet. Cells that can't be sensed or walked on are left out, units are
+  // not, since they move during the turn. Ties go to the direction next in
+  // turn from a per-cell offset, so neighbouring units spread out.
+  MoveList get_moves(const MapInfo &map_info, const PairwiseDistances &pd,
+                     int x, int y, int goal_x, int goal_y);
+
+  // Forgets every field, called once per turn.
+  void clear();
+
+ private:
+  constexpr static uint64_t NOT_COMPUTED = ~0ull;
+
+  map<pair<const PairwiseDistances *, int>, vector<uint64_t>> fields;
+
+  static MoveList compute_moves(const MapInfo &map_info,
+                                const PairwiseDistances &pd, int x, int y,
+                                int goal_x, int goal_y);
+};
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "EnemyMemory.hpp"
+#include "FlowFields.hpp"
 #include "MapInfo.hpp"
+#include "PairwiseDistances.hpp"
+#include "ThreatMap.hpp"
+#include "UnitCache.hpp"
 #include "UnitList.hpp"
 
 using namespace bc;
@@ -18,45 +23,107 @@ struct GameState {
   MapInfo map_info;
 
   UnitList my_units;
+  // Enemies sensed this turn, and the ones seen before.
   UnitList enemy_units;
+  EnemyMemory enemy_memory;
+  ThreatMap threat_map;
+
+  // Cells occupied by a structure, which robots cannot walk through. The
+  // distance tables in `distance_listeners` are repaired as cells change.
+  BitGrid is_blocked;
+  vector<PairwiseDistances*> distance_listeners;
+
+  // Cleared on every update.
+  FlowFields flow_fields;
+  mutable UnitCache unit_cache;
 
   GameState(GameController& gc);
 
+  void add_distance_listener(PairwiseDistances& distances);
+  void block_cell(int x, int y);
+  void unblock_cell(int x, int y);
+
   void update();
 
+  // Blocks cells of structures seen this turn and frees sensed cells without
+  // one.
+  void sync_blocked_cells();
+
   inline bool has_unit_at(int x, int y) const {
-    return my_units.is_occupied[x][y] || enemy_units.is_occupied[x][y];
+    return my_units.is_occupied(x, y) || enemy_units.is_occupied(x, y);
   }
 
-  inline bool has_unit_at(const MapLocation& loc) const {
+  inline bool has_unit_at(const Coord& loc) const {
     return has_unit_at(loc.get_x(), loc.get_y());
   }
 
-  bool is_surrounded(const MapLocation& loc) const;
-  bool is_surrounding_enemy(const MapLocation& loc) const;
-  bool is_safe_location(unsigned x, unsigned y, int radius) const;
+  bool is_surrounded(const Coord& loc) const;
+  bool is_surrounding_enemy(const Coord& loc) const;
+  // Whether no enemy stands within `radius` steps of (x, y). Rangers reach
+  // much further, see threat_map for what could actually attack a cell.
+  inline bool is_safe_location(int x, int y, int radius) const {
+    return !enemy_units.occupied.any_within(x, y, radius);
+  }
 
   unsigned count_obstructions(unsigned x, unsigned y) const;
 
+  // Fields of a unit this turn, fetched once until an action below changes
+  // it. The reference is invalidated by those actions.
+  inline const UnitSnapshot& get_unit(unsigned id) const {
+    return unit_cache.get(gc, id);
+  }
+
   void move(unsigned id, Direction dir);
   void load(unsigned structure_id, unsigned robot_id);
+  void build(unsigned worker_id, unsigned structure_id);
+  void repair(unsigned worker_id, unsigned structure_id);
   unsigned unload(unsigned structure_id, Direction dir);
-  void launch(unsigned rocket_id, const MapLocation& loc);
+  void launch(unsigned rocket_id, const Coord& loc);
   void attack(unsigned id, unsigned target_id);
+  void heal(unsigned id, unsigned target_id);
   void disintegrate(unsigned id);
   bool special_attack(unsigned id, UnitType unit_type, unsigned target_id);
 
+  // The engine's checks of the actions above, answered from the state of
+  // this turn. Cells that weren't sensed at its start, and rocket research,
+  // are left to the engine. Built with CHECK_RULES, every answer is compared
+  // with the engine's and the mismatches are counted.
+  bool can_move(unsigned id, Direction dir) const;
+  bool is_move_ready(unsigned id) const;
+  bool can_attack(unsigned id, unsigned target_id) const;
+  bool is_attack_ready(unsigned id) const;
+  bool can_heal(unsigned id, unsigned target_id) const;
+  bool is_heal_ready(unsigned id) const;
+  bool can_harvest(unsigned id, Direction dir) const;
+  bool can_replicate(unsigned id, Direction dir) const;
+  bool can_blueprint(unsigned id, UnitType unit_type, Direction dir) const;
+  bool can_build(unsigned worker_id, unsigned structure_id) const;
+  bool can_repair(unsigned worker_id, unsigned structure_id) const;
+
+  // Answers of the checks above that the engine disagreed with, this turn.
+  mutable unsigned rule_mismatches = 0;
+
   inline bool can_special_attack(UnitType unit_type) {
     return unit_type == Knight || unit_type == Healer;
   }
 
+  // Removes a unit that was killed, or refreshes its cached health.
   inline void update_if_dead(unsigned id) {
+    unit_cache.invalidate(id);
+    // Units we never sensed, e.g. an enemy out of sight, aren't in a list.
+    if (!enemy_units.contains(id) && !my_units.contains(id)) return;
+    auto& units = enemy_units.contains(id) ? enemy_units : my_units;
     if (!gc.has_unit(id)) {
-      if (enemy_units.by_id.count(id)) {
-        enemy_units.remove(id);
-      } else {
-        my_units.remove(id);
+      const auto unit_type = units.get_type(id);
+      const auto x = units.get_x(id);
+      const auto y = units.get_y(id);
+      units.remove(id);
+      enemy_memory.forget(id);
+      if (unit_type == Factory || unit_type == Rocket) {
+        unblock_cell(x, y);
       }
+    } else if (units.is_sensed(id)) {
+      units.set_health(id, get_unit(id).health);
     }
   }
 
@@ -64,4 +131,26 @@ struct GameState {
   unsigned replicate(unsigned id, Direction dir);
   unsigned blueprint(unsigned id, UnitType unit_type, Direction direction);
   void produce(unsigned factory_id, UnitType unit_type);
+
+ private:
+  // Whether what is on (x, y) is known this turn: it is off the map or was
+  // sensed at the start of the turn.
+  inline bool is_known(int x, int y) const {
+    return !map_info.is_valid_location(x, y) || map_info.can_sense.test(x, y);
+  }
+
+  // Whether a robot could step on a known cell.
+  bool is_free(int x, int y) const;
+
+  // Squared distance between a unit of ours and any unit in sight, or -1 if
+  // the second one isn't.
+  int distance_squared(unsigned id, unsigned other_id) const;
+
+  template <typename EngineAnswer>
+  inline bool check_rule(bool answer, EngineAnswer engine_answer) const {
+#ifdef CHECK_RULES
+    if (answer != engine_answer()) rule_mismatches++;
+#endif
+    return answer;
+  }
 };
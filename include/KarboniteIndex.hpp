@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Karbonite last seen on each cell, and the cells that have some. Karbonite
+// out of sight depreciates by DECAY a round, applied when it is read, so that
+// keeping the index costs a step per deposit rather than per cell. Deposits
+// depreciated to nothing are only estimates, so they are set aside as stale
+// rather than forgotten, until a look shows what is really left.
+struct KarboniteIndex {
+  typedef std::pair<int, int> pii;
+
+  constexpr static float DECAY = 0.99;
+
+  // Side of the square regions karbonite is summed over.
+  constexpr static int REGION_SIZE = 8;
+
+  const int width;
+  const int height;
+  const int region_width;
+  const int region_height;
+
+  // Cells with karbonite, in no particular order.
+  vector<pii> deposits;
+  // Cells that depreciated to nothing without being seen empty.
+  vector<pii> stale;
+
+  KarboniteIndex(int width, int height);
+
+  // Karbonite seen on (x, y) on `round`.
+  void set(int x, int y, float amount, uint32_t round);
+
+  // Karbonite expected on (x, y) on `round`. Less than 1 counts as none.
+  float get(int x, int y, uint32_t round) const;
+
+  // Karbonite last seen in the region of (x, y), before depreciation, so an
+  // upper bound of what is left there.
+  inline float get_region_karbonite(int x, int y) const {
+    return region_karbonite[x / REGION_SIZE * region_height + y / REGION_SIZE];
+  }
+
+  // Moves deposits depreciated to nothing by `round` to `stale`.
+  void prune(uint32_t round);
+
+ private:
+  // Convention: [x * height + y].
+  vector<float> amount;
+  vector<uint32_t> seen_round;
+  // Index in `deposits` and in `stale`, or -1.
+  vector<int> deposit_index;
+  vector<int> stale_index;
+
+  // Convention: [x / REGION_SIZE * region_height + y / REGION_SIZE].
+  vector<float> region_karbonite;
+
+  // DECAY to the power of each age.
+  vector<float> decay;
+
+  void add(vector<pii> &cells, vector<int> &index, int x, int y);
+  void remove(vector<pii> &cells, vector<int> &index, int cell);
+};
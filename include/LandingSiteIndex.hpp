@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include "MapInfo.hpp"
+#include "bc.hpp"
+
+using namespace std;
+using namespace bc;
+
+// Landing sites of a planet ranked once from its starting map, best first.
+struct LandingSiteIndex {
+  typedef std::pair<int, int> pii;
+
+  // Cells within this many steps of a landing are claimed, so that rockets
+  // spread out and don't land on each other.
+  constexpr static int CLAIM_RADIUS = 2;
+
+  // Karbonite within this many steps counts towards a site.
+  constexpr static int KARBONITE_RADIUS = 3;
+
+  const int width;
+  const int height;
+  const Planet planet;
+
+  // Convention: [x][y]. Component of passable terrain, or -1.
+  vector<vector<int>> component;
+  vector<int> component_size;
+
+  // Karbonite of cells [0, x) x [0, y).
+  vector<vector<double>> karbonite_sums;
+
+  // Passable neighbours of each cell.
+  vector<vector<int>> openness;
+
+  vector<pii> ranked_sites;
+  vector<vector<bool>> is_claimed;
+
+  LandingSiteIndex(const MapInfo &map_info);
+
+  // Best site that isn't claimed. Once every site is claimed, the claims are
+  // dropped. Returns false if the planet has no passable cell.
+  bool get_best_site(Coord &site);
+
+  // Claims the cells around a landing.
+  void claim(int x, int y);
+
+  // Initial karbonite in the square of the given radius around a cell.
+  double karbonite_around(int x, int y, int radius) const;
+
+ private:
+  // Every site before it is claimed.
+  size_t next_site;
+
+  void find_components(const MapInfo &map_info);
+};
@@ -1,32 +1,102 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <vector>
+#include "BitGrid.hpp"
+#include "Coord.hpp"
+#include "KarboniteIndex.hpp"
+#include "UnitList.hpp"
 #include "bc.hpp"
+#include "constants.hpp"
 
 using namespace std;
 using namespace bc;
 
+// How a map maps onto itself, by the transform applied to a cell (x, y).
+enum Symmetry {
+  NO_SYMMETRY,
+  HORIZONTAL_SYMMETRY,  // (width - 1 - x, y)
+  VERTICAL_SYMMETRY,    // (x, height - 1 - y)
+  ROTATIONAL_SYMMETRY,  // (width - 1 - x, height - 1 - y)
+};
+
+inline bool flips_x(Symmetry symmetry) {
+  return symmetry == HORIZONTAL_SYMMETRY || symmetry == ROTATIONAL_SYMMETRY;
+}
+
+inline bool flips_y(Symmetry symmetry) {
+  return symmetry == VERTICAL_SYMMETRY || symmetry == ROTATIONAL_SYMMETRY;
+}
+
 struct MapInfo {
   const int width;
   const int height;
   const Planet planet;
 
+  // Round of the last update.
+  uint32_t round;
+
+  KarboniteIndex karbonite;
+
   // Convention: [x][y].
-  vector<vector<float>> karbonite;
   vector<vector<bool>> passable_terrain;
-  vector<vector<bool>> can_sense;
+
+  // Bit masks of passable_terrain and its complement on the map, and of the
+  // cells sensed this turn. Research that widens vision isn't counted, so
+  // can_sense may miss cells in sight, but never has cells out of it.
+  BitGrid passable;
+  BitGrid impassable;
+  BitGrid can_sense;
+
+  // Symmetry of the starting terrain and karbonite.
+  Symmetry symmetry;
 
   MapInfo(const PlanetMap &map);
 
-  void update(const GameController &gc);
+  // Senses the map around `my_units`, and refreshes the karbonite of the
+  // deposits and stale cells in sight and of the asteroids that landed since
+  // the last update.
+  void update(const GameController &gc, const UnitList &my_units);
+
+  inline float get_karbonite(int x, int y) const {
+    return karbonite.get(x, y, round);
+  }
+
+  inline Coord get_location(int x, int y) const { return Coord(planet, x, y); }
 
-  inline MapLocation get_location(int x, int y) const {
-    return MapLocation(planet, x, y);
+  // The same cell as a MapLocation, for API calls, without allocating one.
+  inline const MapLocation &get_map_location(int x, int y) const {
+    return map_locations[x * height + y];
+  }
+  inline const MapLocation &get_map_location(const Coord &loc) const {
+    return get_map_location(loc.get_x(), loc.get_y());
   }
 
-  MapLocation get_random_passable_location() const;
+  Coord get_random_passable_location() const;
 
   inline bool is_valid_location(int x, int y) const {
     return x >= 0 && x < width && y >= 0 && y < height;
   }
+
+  inline int mirror_x(int x) const {
+    return flips_x(symmetry) ? width - 1 - x : x;
+  }
+
+  inline int mirror_y(int y) const {
+    return flips_y(symmetry) ? height - 1 - y : y;
+  }
+
+ private:
+  // Convention: [x * height + y]. Built once, copies allocate.
+  vector<MapLocation> map_locations;
+
+  // First round whose asteroid hasn't been counted yet.
+  uint32_t asteroid_round;
+
+  // Vision of each unit type as (dx, half height) columns: a unit at (x, y)
+  // sees [y - half height, y + half height] of column x + dx.
+  array<vector<pair<int, int>>, constants::N_UNIT_TYPES> vision_columns;
+
+  bool is_symmetric(Symmetry candidate) const;
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include "Coord.hpp"
+#include "PairwiseDistances.hpp"
+#include "bc.hpp"
+
+using namespace std;
+using namespace bc;
+
+// Best weighted target of every cell: the one with the least weight times
+// distance under `pd`. Built with one multi-source BFS per distinct weight,
+// so it costs the same whatever the number of units and targets, and never
+// reads the stored fields of `pd`.
+struct NearestTargetField {
+  const int height;
+
+  NearestTargetField(const PairwiseDistances &pd,
+                     const vector<pair<Coord, float>> &targets);
+
+  // Index of the best target from (x, y), or -1 if none is reachable.
+  inline int get_target(int x, int y) const { return target[x * height + y]; }
+  inline float get_cost(int x, int y) const { return cost[x * height + y]; }
+
+ private:
+  vector<int> target;
+  vector<float> cost;
+};
@@ -1,33 +1,284 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
+#include <string>
 #include <vector>
+#include "MapInfo.hpp"
 #include "bc.hpp"
 #include "constants.hpp"
 
 using namespace bc;
 using namespace std;
 
+// Distances, in moves, from every cell to within `kernel` of every goal, one
+// BFS field per goal. A table either computes every field up front, possibly
+// only half of them on symmetric terrain and possibly mapped from a file of
+// an earlier game, or computes fields on demand into an LRU cache. A derived
+// view answers for another kernel from a movement table. See Config.
 struct PairwiseDistances {
   typedef std::pair<int, int> pii;
-  typedef unsigned short
-      HugeArray[constants::MAX_MAP_SIZE][constants::MAX_MAP_SIZE]
-               [constants::MAX_MAP_SIZE][constants::MAX_MAP_SIZE];
+
+  constexpr static unsigned short UNREACHABLE =
+      numeric_limits<unsigned short>::max();
+
+  // Compact entries saturate at COMPACT_FAR, so any distance of at least
+  // COMPACT_FAR steps reads back as COMPACT_FAR.
+  constexpr static uint8_t COMPACT_FAR = 254;
+  constexpr static uint8_t COMPACT_UNREACHABLE = 255;
+
+  struct Config {
+    // Memory budget in bytes for goal fields that are computed on demand, the
+    // first time a goal is queried, and kept in an LRU cache. Zero computes
+    // the fields of every goal up front instead.
+    size_t cache_budget;
+
+    // Store distances in a single byte instead of two.
+    bool compact;
+
+    // Number of threads computing the fields of every goal up front. Zero
+    // uses the DISTANCE_THREADS environment variable if set, and the hardware
+    // concurrency otherwise.
+    unsigned n_threads;
+
+    // Directory of tables saved by earlier games, keyed by a hash of the
+    // terrain and kernel. A table found there is mapped read-only instead of
+    // computed, otherwise the computed table is saved there. Empty disables
+    // it. Only used when computing every field up front. The directory is
+    // created private, and it and its files are only trusted if they belong
+    // to the current user and nobody else can write to them.
+    string cache_dir;
+
+    // Symmetry of the terrain, see MapInfo::symmetry. Only one field of each
+    // mirrored pair of goals is stored, and queries for the other goal are
+    // mirrored. Ignored if the terrain or kernel is not actually symmetric.
+    Symmetry symmetry;
+
+    Config()
+        : cache_budget(0),
+          compact(false),
+          n_threads(1),
+          symmetry(NO_SYMMETRY) {}
+  };
 
   int width, height;
-  HugeArray *distances;
+  int field_size;
+  bool compact;
+  bool lazy;
+
+  // Derived views follow the symmetry of their movement table. Lazy tables
+  // drop it on the first block() or unblock(), since blocked cells need not
+  // be symmetric, while eager tables keep mirroring their stored fields.
+  Symmetry symmetry;
 
-  /// Takes a collision map `coll`
+  // `n_slots` goal fields of `field_size` entries each, stored back to back
+  // and indexed by [start_x * height + start_y]. Only one of the two is set,
+  // depending on `compact`, and points into `owned_fields` or into
+  // `mapping`. The slot of a goal is [goal_x * height + goal_y], unless the
+  // table is lazy or symmetric. The fields of eager tables are never written
+  // after they are computed or mapped, see `overlay_fields`.
+  int n_slots;
+  unsigned short *wide_fields;
+  uint8_t *compact_fields;
+  vector<uint8_t> owned_fields;
+
+  // Read-only mapping of a cached table file, or null.
+  void *mapping;
+  size_t mapping_size;
+
+  // Slot of each goal and goal of each slot, or -1, for lazy or symmetric
+  // tables. Only the ones of lazy tables change.
+  mutable vector<int> slot_of_goal;
+  mutable vector<int> goal_of_slot;
+
+  // Lazy mode.
+  mutable vector<int> lru_prev;
+  mutable vector<int> lru_next;
+  mutable int lru_head;  // Most recently used.
+  mutable int lru_tail;  // Least recently used.
+  mutable int n_used_slots;
+
+  mutable unsigned long cache_hits;
+  mutable unsigned long cache_misses;
+
+  // Eager tables: fields of the goals that block() and unblock() changed
+  // beyond the blocked cells themselves, whole and unfolded, indexed like
+  // the stored fields. Other goals read their stored field, with blocked
+  // cells UNREACHABLE on top.
+  vector<uint8_t> overlay_fields;
+  // Overlay of each goal, or -1.
+  vector<int> overlay_of_goal;
+  int n_overlays;
+
+  // Derived mode: the movement table this view reads from, or null.
+  const PairwiseDistances *movement;
+
+#ifdef CHECK_DISTANCES
+  // Entries that differed from a fresh BFS after a block() or unblock(), and
+  // the fields that had to be computed again because of COMPACT_FAR.
+  unsigned long repair_mismatches = 0;
+  unsigned long n_recomputed_fields = 0;
+#endif
+
+  // Table of `passable_terrain`, indexed by [x][y], for goals with `kernel`
+  // around them, stored and computed as `config` says.
   PairwiseDistances(const vector<vector<bool>> &passable_terrain,
+                    const vector<pii> &kernel,
+                    const Config &config = Config());
+
+  /// Distance to get within `kernel` of the goal, derived on query from a
+  /// `movement` table built with constants::POINT_KERNEL, which must outlive
+  /// this view. Since movement distances are symmetric, this is the minimum of
+  /// the movement field of the start over the kernel around the goal.
+  PairwiseDistances(const PairwiseDistances &movement,
                     const vector<pii> &kernel);
 
+  PairwiseDistances(const PairwiseDistances &) = delete;
+  PairwiseDistances &operator=(const PairwiseDistances &) = delete;
+
   unsigned short get_distance(int start_x, int start_y, int goal_x,
                               int goal_y) const;
   unsigned short get_distance(const MapLocation &start,
                               const MapLocation &goal) const;
 
+  // Multi-source BFS over the same moves as the stored fields, without
+  // reading them: `distance` to get within the kernel of the nearest of
+  // `goals` from every cell, and the index of that goal in `nearest`, both
+  // indexed by [x * height + y]. Ties go to the earlier goal. Cells that
+  // can't get to any goal have UNREACHABLE and -1.
+  void compute_nearest(const vector<pii> &goals,
+                       vector<unsigned short> &distance,
+                       vector<int> &nearest) const;
+
+  // Bytes of fields owned by this table, not counting mapped files.
+  size_t memory_usage() const;
+
+  // Marks a passable cell as blocked or free again, e.g. by a structure, and
+  // repairs the computed fields. A blocked cell is unreachable, like
+  // impassable terrain, so only the cells of the kernel around a goal that
+  // are not blocked start its field: with POINT_KERNEL the field of a blocked
+  // goal is all UNREACHABLE, and getting next to it is a query for a derived
+  // view with a wider kernel.
+  //
+  // Only entries whose distance changes are touched. Lazy tables repair
+  // their cached fields in place. Eager tables keep their stored fields, so
+  // that mapped files stay shared and symmetric tables stay half size, and
+  // copy a goal's field into `overlay_fields` the first time its distances
+  // change beyond the blocked cells, which in open ground is rare. Compact
+  // fields where the change reaches entries saturated at COMPACT_FAR are
+  // computed again, since those can't tell far from cut off. Not allowed on
+  // derived views, which follow their movement table.
+  void block(int x, int y);
+  void unblock(int x, int y);
+  inline bool is_blocked(int x, int y) const {
+    return (terrain[x] & ~pass[x]) >> y & 1;
+  }
+
   ~PairwiseDistances();
+
+ private:
+  // Bitboards: bit `y` of row `x` is cell (x, y).
+  typedef uint64_t Rows[constants::MAX_MAP_SIZE];
+  static_assert(constants::MAX_MAP_SIZE <= 64, "A row must fit in a word.");
+
+  // Per-thread BFS buffers.
+  struct Scratch {
+    Rows visited;
+    Rows frontier;
+    Rows next_frontier;
+  };
+
+  // Runs of kernel offsets (dx, dy) with dy in [dy_lo, dy_hi].
+  struct Span {
+    int dx;
+    int dy_lo;
+    int dy_hi;
+  };
+
+  // Passable terrain, and the subset of it that is not blocked.
+  Rows terrain;
+  Rows pass;
+  int n_blocked;
+  vector<pii> kernel;
+  vector<Span> kernel_spans;
+  // BFS buffers of everything but compute_all_slots(), which runs on threads.
+  mutable Scratch serial_scratch;
+
+  // Bit-parallel BFS from the kernel around the goal into the `field_size`
+  // entries at `field`. Each wavefront expands in all 8 directions at once
+  // with shifts of whole rows.
+  template <typename T>
+  void compute_field(int goal_x, int goal_y, T *field, Scratch &scratch) const;
+  void compute_slot(int slot, int goal_x, int goal_y, Scratch &scratch) const;
+  void compute_all_slots(unsigned n_threads);
+  void allocate_fields();
+  void build_kernel_spans();
+  bool in_kernel(int dx, int dy) const;
+
+  bool has_symmetry(Symmetry candidate) const;
+  void mirror(int &x, int &y) const;
+  // Whether the field of a goal is stored, rather than the one of its mirror.
+  bool is_canonical(int goal_x, int goal_y) const;
+
+  // What blocking (x, y) does to a field.
+  enum Cut {
+    UNCHANGED,  // Only (x, y) becomes unreachable.
+    CUT,        // So do the shortest paths of the cells in `cut`.
+    RECOMPUTE,  // The change reaches entries saturated at COMPACT_FAR.
+  };
+  // Finds the cells that lose all their shortest paths to the goal when (x,
+  // y) is blocked, reading the field before the block through `read`.
+  template <typename T, typename Read>
+  Cut find_cut(Read read, int x, int y, Rows &cut_mask,
+               vector<pii> &cut) const;
+  // Settles the cells of `cut` again from the rest of the field.
+  template <typename T>
+  void settle_cut(T *field, const Rows &cut_mask, const vector<pii> &cut) const;
+
+  template <typename T>
+  void block_fields(T *fields, int x, int y);
+  template <typename T>
+  void unblock_fields(T *fields, int x, int y);
+  template <typename T>
+  void repair_block(T *field, int goal_x, int goal_y, int x, int y);
+  template <typename T>
+  void repair_unblock(T *field, int goal_x, int goal_y, int x, int y) const;
+
+  // Entry of the stored field of a goal, mirrored if need be.
+  template <typename T>
+  T get_stored(const T *fields, int goal_x, int goal_y, int x, int y) const;
+  // Copies the stored field of a goal into a new overlay, with the blocked
+  // cells unreachable, and returns it.
+  template <typename T>
+  T *add_overlay(const T *fields, int goal_x, int goal_y);
+  // Overlay of a goal, or null.
+  template <typename T>
+  const T *get_overlay(int goal) const;
+
+#ifdef CHECK_DISTANCES
+  template <typename T>
+  void check_repairs();
+#endif
+
+  size_t fields_bytes() const;
+  uint64_t table_hash() const;
+  bool map_table_file(const string &path);
+  void write_table_file(const string &path) const;
+
+  // Skips the blocked cells of the movement table, which its stored fields
+  // don't know about, mirrored if the field is.
+  template <typename T>
+  unsigned short get_derived_distance(const T *field, int goal_x, int goal_y,
+                                      bool is_mirrored) const;
+
+  int get_slot(int goal_x, int goal_y) const;
+  void lru_unlink(int slot) const;
+  void lru_push_front(int slot) const;
 };
 
+// Number of threads to use for `requested` threads, see Config::n_threads.
+unsigned resolve_thread_count(unsigned requested);
+
 // Takes square distances
 vector<pair<int, int>> make_kernel(int min_distance_squared,
                                    int max_distance_squared);
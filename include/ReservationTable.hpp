@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include "GameState.hpp"
+#include "PairwiseDistances.hpp"
+#include "bc.hpp"
+
+using namespace std;
+using namespace bc;
+
+// Cooperative pathfinding: units claim the cells of their next steps, turn by
+// turn, in the order they were added, and later units plan around the claims.
+// A unit may step into the cell of a unit that leaves it first, so that lines
+// of units move as a whole. Swaps and rotations are never planned, since moves
+// happen one at a time.
+struct ReservationTable {
+  // Turns planned ahead, only the first one is carried out.
+  constexpr static int HORIZON = 3;
+
+  ReservationTable(int width, int height);
+
+  void add(unsigned id, const Coord &goal, const PairwiseDistances &pd);
+
+  // Plans and moves every added unit. Returns how many units moved.
+  unsigned execute(GameState &game_state);
+
+ private:
+  struct Request {
+    unsigned id;
+    int goal_x;
+    int goal_y;
+    const PairwiseDistances *pd;
+
+    // Cell at every turn up to HORIZON, or -1 until planned.
+    int path[HORIZON + 1];
+    Direction first_step;
+  };
+
+  enum State { PENDING, MOVING, MOVED, STAYED };
+
+  const int width;
+  const int height;
+  vector<Request> requests;
+
+  // Request holding each cell at each turn, or -1.
+  vector<int> reserved;
+
+  // Request starting on each cell, or -1.
+  vector<int> starting_at;
+
+  inline int &reservation(int turn, int cell) {
+    return reserved[turn * width * height + cell];
+  }
+
+  void plan(GameState &game_state, int request);
+  bool can_enter(GameState &game_state, int request, int turn, int cell);
+  bool leads_back_to(int request, int other) const;
+  void move(GameState &game_state, int request, vector<char> &state);
+};
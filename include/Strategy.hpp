@@ -7,7 +7,11 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "Assignment.hpp"
 #include "GameState.hpp"
+#include "LandingSiteIndex.hpp"
+#include "NearestTargetField.hpp"
+#include "ReservationTable.hpp"
 #include "TargetSearch.hpp"
 #include "constants.hpp"
 #include "silly_pathfinding.hpp"
@@ -17,7 +21,7 @@ using namespace std;
 class Strategy {
  public:
   virtual ~Strategy() {}
-  virtual bool run(GameState &game_state, unordered_set<unsigned> units) = 0;
+  virtual bool run(GameState &game_state, const vector<unsigned> &units) = 0;
 };
 
 class RobotStrategy : public Strategy {
@@ -41,11 +45,11 @@ class RobotStrategy : public Strategy {
 
  protected:
   void maybe_move(GameState &game_state, unsigned unit_id,
-                  const MapLocation &goal, const PairwiseDistances &pd) {
-    const auto loc = game_state.my_units.by_id[unit_id].second;
-    const auto dir = silly_pathfinding(game_state, loc, goal, pd);
-    if (game_state.gc.can_move(unit_id, dir) &&
-        game_state.gc.is_move_ready(unit_id)) {
+                  const Coord &goal, const PairwiseDistances &pd) {
+    const auto loc = game_state.my_units.get_location(unit_id);
+    const auto dir = flow_pathfinding(game_state, loc, goal, pd);
+    if (game_state.can_move(unit_id, dir) &&
+        game_state.is_move_ready(unit_id)) {
       game_state.move(unit_id, dir);
     }
   }
@@ -54,8 +58,8 @@ class RobotStrategy : public Strategy {
     auto seed = rand();
     for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
       auto dir = static_cast<Direction>((i + seed) % 8);
-      if (game_state.gc.can_move(unit_id, dir) &&
-          game_state.gc.is_move_ready(unit_id)) {
+      if (game_state.can_move(unit_id, dir) &&
+          game_state.is_move_ready(unit_id)) {
         game_state.move(unit_id, dir);
         return;
       }
@@ -63,7 +67,7 @@ class RobotStrategy : public Strategy {
   }
 
   bool maybe_board_rocket(GameState &game_state, unsigned unit_id) {
-    const auto loc = game_state.my_units.by_id[unit_id].second;
+    const auto loc = game_state.my_units.get_location(unit_id);
     const auto robot_x = loc.get_x();
     const auto robot_y = loc.get_y();
 
@@ -72,10 +76,10 @@ class RobotStrategy : public Strategy {
       const auto probe_y = robot_y + constants::DY[i];
 
       if (!game_state.map_info.is_valid_location(probe_x, probe_y)) continue;
-      if (!game_state.my_units.is_occupied[probe_x][probe_y]) continue;
+      if (!game_state.my_units.is_occupied(probe_x, probe_y)) continue;
 
-      const auto other_id = game_state.my_units.by_location[probe_x][probe_y];
-      const auto other_type = game_state.my_units.by_id[other_id].first;
+      const auto other_id = game_state.my_units.get_id_at(probe_x, probe_y);
+      const auto other_type = game_state.my_units.get_type(other_id);
       if (other_type != Rocket) continue;
 
       // It's a rocket!
@@ -90,7 +94,7 @@ class RobotStrategy : public Strategy {
 
 class NullRobotStrategy : public RobotStrategy {
  public:
-  bool run(GameState &game_state, unordered_set<unsigned> units) {
+  bool run(GameState &game_state, const vector<unsigned> &units) {
     return true;
   }
 };
@@ -117,22 +121,22 @@ class WorkerStrategy : public RobotStrategy {
 
  protected:
   void maybe_move_and_replicate(GameState &game_state, unsigned worker_id,
-                                const MapLocation &goal,
+                                const Coord &goal,
                                 const PairwiseDistances &pd, bool should_move,
                                 bool should_replicate) {
-    auto loc = game_state.my_units.by_id[worker_id].second;
+    auto loc = game_state.my_units.get_location(worker_id);
     if (should_move) {
-      const auto dir = silly_pathfinding(game_state, loc, goal, pd);
-      if (game_state.gc.can_move(worker_id, dir) &&
-          game_state.gc.is_move_ready(worker_id)) {
+      const auto dir = flow_pathfinding(game_state, loc, goal, pd);
+      if (game_state.can_move(worker_id, dir) &&
+          game_state.is_move_ready(worker_id)) {
         game_state.move(worker_id, dir);
         loc = loc.add(dir);
       }
     }
 
     if (should_replicate) {
-      const auto dir = silly_pathfinding(game_state, loc, goal, pd);
-      if (game_state.gc.can_replicate(worker_id, dir)) {
+      const auto dir = flow_pathfinding(game_state, loc, goal, pd);
+      if (game_state.can_replicate(worker_id, dir)) {
         const auto replicated_id = game_state.replicate(worker_id, dir);
         return maybe_move_and_replicate(game_state, replicated_id, goal, pd,
                                         true, false);
@@ -141,7 +145,7 @@ class WorkerStrategy : public RobotStrategy {
         for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
           const auto dir = static_cast<Direction>(
               (i + seed) % constants::N_DIRECTIONS_WITHOUT_CENTER);
-          if (game_state.gc.can_replicate(worker_id, dir)) {
+          if (game_state.can_replicate(worker_id, dir)) {
             const auto replicated_id = game_state.replicate(worker_id, dir);
             return maybe_move_and_replicate(game_state, replicated_id, goal, pd,
                                             true, false);
@@ -162,8 +166,9 @@ class WorkerStrategy : public RobotStrategy {
       for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
         const auto dir = static_cast<Direction>(
             (i + seed) % constants::N_DIRECTIONS_WITHOUT_CENTER);
-        if (game_state.gc.can_move(worker_id, dir) &&
-            game_state.gc.is_move_ready(worker_id)) {
+        if (!is_safe_move(game_state, worker_id, dir)) continue;
+        if (game_state.can_move(worker_id, dir) &&
+            game_state.is_move_ready(worker_id)) {
           game_state.move(worker_id, dir);
           break;
         }
@@ -175,7 +180,7 @@ class WorkerStrategy : public RobotStrategy {
       for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
         const auto dir = static_cast<Direction>(
             (i + seed) % constants::N_DIRECTIONS_WITHOUT_CENTER);
-        if (game_state.gc.can_replicate(worker_id, dir)) {
+        if (game_state.can_replicate(worker_id, dir)) {
           const auto replicated_id = game_state.replicate(worker_id, dir);
           return maybe_move_and_replicate_randomly(game_state, replicated_id,
                                                    true, false);
@@ -187,8 +192,21 @@ class WorkerStrategy : public RobotStrategy {
     if (maybe_harvest(game_state, worker_id)) return;
   }
 
+  // Whether moving doesn't take the worker into more danger than it is in.
+  // Wandering workers step away from enemies, never towards them.
+  bool is_safe_move(const GameState &game_state, unsigned worker_id,
+                    Direction dir) {
+    const auto x = game_state.my_units.get_x(worker_id);
+    const auto y = game_state.my_units.get_y(worker_id);
+    const auto next_x = x + constants::DX[dir];
+    const auto next_y = y + constants::DY[dir];
+    if (!game_state.map_info.is_valid_location(next_x, next_y)) return false;
+    return game_state.threat_map.get_damage(next_x, next_y) <=
+           game_state.threat_map.get_damage(x, y);
+  }
+
   bool maybe_harvest(GameState &game_state, unsigned worker_id) {
-    const auto loc = game_state.my_units.by_id[worker_id].second;
+    const auto loc = game_state.my_units.get_location(worker_id);
     const auto worker_x = loc.get_x();
     const auto worker_y = loc.get_y();
 
@@ -201,9 +219,10 @@ class WorkerStrategy : public RobotStrategy {
       const auto probe_y = worker_y + constants::DY[i];
       if (!game_state.map_info.is_valid_location(probe_x, probe_y)) continue;
 
-      if (game_state.gc.can_harvest(worker_id, dir)) {
+      if (game_state.can_harvest(worker_id, dir)) {
         can_harvest = true;
-        const auto karbonite = game_state.map_info.karbonite[probe_x][probe_y];
+        const auto karbonite =
+            game_state.map_info.get_karbonite(probe_x, probe_y);
         if (karbonite > max_karbonite) {
           max_karbonite = karbonite;
           best_dir = dir;
@@ -220,7 +239,7 @@ class WorkerStrategy : public RobotStrategy {
   }
 
   bool maybe_build_or_repair(GameState &game_state, unsigned worker_id) {
-    const auto loc = game_state.my_units.by_id[worker_id].second;
+    const auto loc = game_state.my_units.get_location(worker_id);
     const auto worker_x = loc.get_x();
     const auto worker_y = loc.get_y();
 
@@ -230,17 +249,16 @@ class WorkerStrategy : public RobotStrategy {
       const auto probe_y = worker_y + constants::DY[i];
 
       if (!game_state.map_info.is_valid_location(probe_x, probe_y)) continue;
-      if (!game_state.my_units.is_occupied[probe_x][probe_y]) continue;
-      const auto unit_id = game_state.my_units.by_location[probe_x][probe_y];
-      const auto unit_type = game_state.my_units.by_id[unit_id].first;
+      if (!game_state.my_units.is_occupied(probe_x, probe_y)) continue;
+      const auto unit_id = game_state.my_units.get_id_at(probe_x, probe_y);
+      const auto unit_type = game_state.my_units.get_type(unit_id);
 
       if (unit_type != Factory && unit_type != Rocket) continue;
 
-      const auto unit = game_state.gc.get_unit(unit_id);
-      if (unit.structure_is_built()) continue;
-      if (!game_state.gc.can_build(worker_id, unit_id)) continue;
+      if (game_state.get_unit(unit_id).is_built) continue;
+      if (!game_state.can_build(worker_id, unit_id)) continue;
 
-      game_state.gc.build(worker_id, unit_id);
+      game_state.build(worker_id, unit_id);
 
       return true;
     }
@@ -251,19 +269,19 @@ class WorkerStrategy : public RobotStrategy {
       const auto probe_y = worker_y + constants::DY[i];
 
       if (!game_state.map_info.is_valid_location(probe_x, probe_y)) continue;
-      if (!game_state.my_units.is_occupied[probe_x][probe_y]) continue;
-      const auto unit_id = game_state.my_units.by_location[probe_x][probe_y];
-      const auto unit_type = game_state.my_units.by_id[unit_id].first;
+      if (!game_state.my_units.is_occupied(probe_x, probe_y)) continue;
+      const auto unit_id = game_state.my_units.get_id_at(probe_x, probe_y);
+      const auto unit_type = game_state.my_units.get_type(unit_id);
 
       if (unit_type != Factory && unit_type != Rocket) continue;
 
-      const auto unit = game_state.gc.get_unit(unit_id);
-      if (!unit.structure_is_built()) continue;
-      if (unit.get_health() == unit.get_max_health()) continue;
+      const auto &unit = game_state.get_unit(unit_id);
+      if (!unit.is_built) continue;
+      if (unit.health == unit.max_health) continue;
 
-      if (!game_state.gc.can_repair(worker_id, unit_id)) continue;
+      if (!game_state.can_repair(worker_id, unit_id)) continue;
 
-      game_state.gc.repair(worker_id, unit_id);
+      game_state.repair(worker_id, unit_id);
 
       return true;
     }
@@ -273,7 +291,7 @@ class WorkerStrategy : public RobotStrategy {
 
   bool maybe_blueprint(GameState &game_state, unsigned worker_id,
                        UnitType unit_type) {
-    const auto loc = game_state.my_units.by_id[worker_id].second;
+    const auto loc = game_state.my_units.get_location(worker_id);
     const auto worker_x = loc.get_x();
     const auto worker_y = loc.get_y();
 
@@ -282,13 +300,14 @@ class WorkerStrategy : public RobotStrategy {
       const auto probe_x = worker_x + constants::DX[i];
       const auto probe_y = worker_y + constants::DY[i];
 
+      if (!game_state.map_info.is_valid_location(probe_x, probe_y)) continue;
       if (game_state.count_obstructions(probe_x, probe_y) >= MAX_OBSTRUCTIONS)
         continue;
 
       if (!game_state.is_safe_location(probe_x, probe_y, 1)) continue;
 
       const auto dir = static_cast<Direction>(i);
-      if (game_state.gc.can_blueprint(worker_id, unit_type, dir)) {
+      if (game_state.can_blueprint(worker_id, unit_type, dir)) {
         game_state.blueprint(worker_id, unit_type, dir);
         return true;
       }
@@ -300,47 +319,53 @@ class WorkerStrategy : public RobotStrategy {
 
 class WorkerRushStrategy : public WorkerStrategy {
  protected:
-  const PairwiseDistances distances;
+  // Karbonite in a region of KarboniteIndex::REGION_SIZE squared cells from
+  // which its deposits are the cheapest to go to.
+  constexpr static float RICH_REGION_KARBONITE = 300;
+
+  const PairwiseDistances &distances;
 
  public:
   WorkerRushStrategy(const PairwiseDistances &distances)
       : distances(distances) {}
 
-  bool run(GameState &game_state, unordered_set<unsigned> workers) {
-    vector<pair<MapLocation, float>> target_locations;
+  bool run(GameState &game_state, const vector<unsigned> &workers) {
+    vector<pair<Coord, float>> target_locations;
 
     if (should_move_to_enemy) {
-      for (const auto &unit : game_state.enemy_units.by_id) {
-        const auto loc = unit.second.second;
+      const auto &enemies = game_state.enemy_units;
+      for (size_t slot = 0; slot < enemies.size(); slot++) {
+        const auto loc = game_state.map_info.get_location(enemies.xs[slot],
+                                                          enemies.ys[slot]);
         target_locations.push_back(make_pair(loc, 0.5));
       }
     }
 
     if (should_move_to_unbuilt_rockets || should_move_to_rockets) {
-      for (const auto rocket_id : game_state.my_units.by_type[Rocket]) {
-        const auto rocket_unit = game_state.gc.get_unit(rocket_id);
+      for (const auto rocket_id : game_state.my_units.of_type(Rocket)) {
+        const auto &rocket_unit = game_state.get_unit(rocket_id);
         if (!should_move_to_rockets) {
-          if (rocket_unit.structure_is_built()) continue;
+          if (rocket_unit.is_built) continue;
         }
 
         float score =
-            0.5 + 0.5 * rocket_unit.get_health() / rocket_unit.get_max_health();
+            0.5 + 0.5 * rocket_unit.health / rocket_unit.max_health;
 
-        const auto loc = game_state.my_units.by_id[rocket_id].second;
+        const auto loc = game_state.my_units.get_location(rocket_id);
         target_locations.push_back(make_pair(loc, score));
       }
     }
 
     if (should_move_to_unbuilt_factories || should_move_to_factories) {
-      for (const auto factory_id : game_state.my_units.by_type[Factory]) {
-        const auto factory_unit = game_state.gc.get_unit(factory_id);
+      for (const auto factory_id : game_state.my_units.of_type(Factory)) {
+        const auto &factory_unit = game_state.get_unit(factory_id);
         if (!should_move_to_factories) {
-          if (factory_unit.structure_is_built()) continue;
+          if (factory_unit.is_built) continue;
         }
 
-        float score = 0.5 + 0.5 * factory_unit.get_health() /
-                                factory_unit.get_max_health();
-        const auto loc = game_state.my_units.by_id[factory_id].second;
+        float score =
+            0.5 + 0.5 * factory_unit.health / factory_unit.max_health;
+        const auto loc = game_state.my_units.get_location(factory_id);
         target_locations.push_back(make_pair(loc, score));
       }
     }
@@ -351,16 +376,16 @@ class WorkerRushStrategy : public WorkerStrategy {
       const auto y = loc.first.get_y();
       const uint16_t hash = (x << 8) + y;
 
-      const auto unit_id = game_state.my_units.by_location[x][y];
+      const auto unit_id = game_state.my_units.get_id_at(x, y);
 
-      if (game_state.my_units.by_id[unit_id].first == Rocket) {
-        const auto unit = game_state.gc.get_unit(unit_id);
-        if (unit.structure_is_built()) {
-          const vector<unsigned> garrison = unit.get_structure_garrison();
+      if (game_state.my_units.is_occupied(x, y) &&
+          game_state.my_units.get_type(unit_id) == Rocket) {
+        const auto &unit = game_state.get_unit(unit_id);
+        if (unit.is_built) {
           int worker_count = 0;
-          for (const auto &garrison_unit_id : garrison) {
-            const auto garrison_unit = game_state.gc.get_unit(garrison_unit_id);
-            if (garrison_unit.get_unit_type() == Worker) {
+          for (const auto &garrison_unit_id : unit.garrison) {
+            const auto &garrison_unit = game_state.get_unit(garrison_unit_id);
+            if (garrison_unit.unit_type == Worker) {
               worker_count++;
             }
           }
@@ -368,7 +393,7 @@ class WorkerRushStrategy : public WorkerStrategy {
           continue;
         }
       }
-      if (game_state.map_info.can_sense[x][y]) {
+      if (game_state.map_info.can_sense.test(x, y)) {
         n_max_targetting[hash] = constants::N_DIRECTIONS_WITHOUT_CENTER -
                                  game_state.count_obstructions(x, y) + 1;
       } else {
@@ -377,44 +402,50 @@ class WorkerRushStrategy : public WorkerStrategy {
     }
 
     if (should_move_to_karbonite) {
-      for (int x = 0; x < game_state.map_info.width; x++) {
-        for (int y = 0; y < game_state.map_info.height; y++) {
-          if (game_state.map_info.karbonite[x][y]) {
-            // Check if already being targeted.
-            const uint16_t hash = (x << 8) + y;
-            if (n_max_targetting.count(hash)) continue;
-
-            const auto loc = game_state.map_info.get_location(x, y);
-            target_locations.push_back(make_pair(loc, 0.8));
-            n_max_targetting[hash] = 1;
-          }
-        }
+      const auto &karbonite = game_state.map_info.karbonite;
+      for (const auto &deposit : karbonite.deposits) {
+        const auto x = deposit.first;
+        const auto y = deposit.second;
+
+        // Check if already being targeted.
+        const uint16_t hash = (x << 8) + y;
+        if (n_max_targetting.count(hash)) continue;
+
+        // Deposits in rich regions are worth a longer walk than lone ones.
+        const auto richness = min(
+            1.f, karbonite.get_region_karbonite(x, y) / RICH_REGION_KARBONITE);
+        const auto loc = game_state.map_info.get_location(x, y);
+        target_locations.push_back(make_pair(loc, 0.9 - 0.2 * richness));
+        n_max_targetting[hash] = 1;
       }
     }
 
-    const auto targets = find_targets_with_weights(game_state, workers,
-                                                   target_locations, distances);
+    vector<AssignmentTarget> assignment_targets;
+    for (const auto &target_location : target_locations) {
+      const auto &loc = target_location.first;
+      const uint16_t hash = (loc.get_x() << 8) + loc.get_y();
+
+      // Only units next to a surrounded target can get to it.
+      const auto max_cost = game_state.is_surrounded(loc)
+                                ? 1
+                                : numeric_limits<float>::infinity();
+      assignment_targets.push_back(
+          AssignmentTarget(loc, target_location.second,
+                           (int)n_max_targetting[hash], max_cost));
+    }
+
+    const auto targets =
+        assign_targets(game_state, workers, assignment_targets, distances);
 
-    unordered_map<uint16_t, unsigned> n_targetting;
     unordered_set<unsigned> targetting;
 
     // Move towards target.
     for (const auto &target : targets) {
-      if (target.distance == numeric_limits<uint16_t>::max()) continue;
-
-      const uint16_t hash = (target.x << 8) + target.y;
-      if (n_targetting[hash] >= n_max_targetting[hash]) continue;
-      if (targetting.count(target.id)) continue;
-
       const auto goal = game_state.map_info.get_location(target.x, target.y);
-      if (game_state.is_surrounded(goal) && target.distance > 1) continue;
-
-      n_targetting[hash]++;
       targetting.insert(target.id);
 
-      const auto unit_loc = game_state.my_units.by_id[target.id].second;
-      const auto unit_x = unit_loc.get_x();
-      const auto unit_y = unit_loc.get_y();
+      const auto unit_x = game_state.my_units.get_x(target.id);
+      const auto unit_y = game_state.my_units.get_y(target.id);
       const auto should_move =
           should_move_worker(game_state, unit_x, unit_y, target.x, target.y);
 
@@ -424,7 +455,7 @@ class WorkerRushStrategy : public WorkerStrategy {
 
     // Explore.
     vector<unsigned> units_to_be_moved_randomly =
-        random_move_order(game_state, workers, targetting);
+        random_move_order(game_state, targetting);
     for (const auto id : units_to_be_moved_randomly) {
       maybe_move_and_replicate_randomly(game_state, id, true, should_replicate);
     }
@@ -443,7 +474,7 @@ class WorkerRushStrategy : public WorkerStrategy {
       if (!game_state.map_info.is_valid_location(x, y)) continue;
       if (x == target_x && y == target_y) return true;
 
-      if (game_state.enemy_units.is_occupied[x][y]) {
+      if (game_state.enemy_units.is_occupied(x, y)) {
         const auto enemy_loc = game_state.map_info.get_location(x, y);
         if (game_state.is_surrounded(enemy_loc)) return false;
       }
@@ -453,8 +484,7 @@ class WorkerRushStrategy : public WorkerStrategy {
   }
 
   vector<unsigned> random_move_order(GameState &game_state,
-                                     unordered_set<unsigned> workers,
-                                     unordered_set<unsigned> unmovable) {
+                                     const unordered_set<unsigned> &unmovable) {
     vector<vector<bool>> visited(
         game_state.map_info.width,
         vector<bool>(game_state.map_info.height, false));
@@ -492,12 +522,12 @@ class WorkerRushStrategy : public WorkerStrategy {
 
         if (x >= 0 && x < game_state.map_info.width && y >= 0 &&
             y < game_state.map_info.width && !visited[x][y] &&
-            game_state.my_units.is_occupied[x][y]) {
-          auto id = game_state.my_units.by_location[x][y];
+            game_state.my_units.is_occupied(x, y)) {
+          auto id = game_state.my_units.get_id_at(x, y);
           if (unmovable.count(id) != 0) continue;
-          if (!workers.count(id)) continue;
+          if (game_state.my_units.get_type(id) != Worker) continue;
 
-          if (!game_state.gc.is_move_ready(id)) continue;
+          if (!game_state.is_move_ready(id)) continue;
 
           units_to_be_moved.push_back(id);
           q.push(make_pair(x, y));
@@ -516,7 +546,7 @@ class BuildingStrategy : public WorkerStrategy {
  public:
   BuildingStrategy(const UnitType unit_type) : unit_type(unit_type) {}
 
-  bool run(GameState &game_state, unordered_set<unsigned> workers) {
+  bool run(GameState &game_state, const vector<unsigned> &workers) {
     // FIXME: At least build randomly / safely instead of first that can.
     for (const auto worker_id : workers) {
       if (maybe_blueprint(game_state, worker_id, unit_type)) return true;
@@ -527,7 +557,7 @@ class BuildingStrategy : public WorkerStrategy {
 
 class RocketBoardingStrategy : public RobotStrategy {
  public:
-  bool run(GameState &game_state, unordered_set<unsigned> robots) {
+  bool run(GameState &game_state, const vector<unsigned> &robots) {
     auto did_board = false;
     for (const auto robot_id : robots) {
       if (maybe_board_rocket(game_state, robot_id)) did_board = true;
@@ -538,13 +568,12 @@ class RocketBoardingStrategy : public RobotStrategy {
 
 class UnboardingStrategy : public Strategy {
  public:
-  bool run(GameState &game_state, unordered_set<unsigned> structures) {
+  bool run(GameState &game_state, const vector<unsigned> &structures) {
     auto did_unboard = false;
     for (const auto structure_id : structures) {
-      const auto structure_unit = game_state.gc.get_unit(structure_id);
-      const auto garrison = structure_unit.get_structure_garrison();
+      // Copied, unloading invalidates the snapshot.
+      const auto garrison = game_state.get_unit(structure_id).garrison;
       for (int j = 0; j < (int)garrison.size(); j++) {
-        MapLocation ml = structure_unit.get_map_location();
         for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
           auto dir = Direction(i);
           if (game_state.gc.can_unload(structure_id, dir)) {
@@ -560,33 +589,37 @@ class UnboardingStrategy : public Strategy {
 
 class RocketLaunchingStrategy : public Strategy {
  protected:
-  const MapInfo mars_map_info;
+  LandingSiteIndex landing_sites;
   const unsigned MIN_UNITS_TO_LAUNCH = 4;
 
  public:
   RocketLaunchingStrategy(GameState &game_state)
-      : mars_map_info(game_state.gc.get_starting_planet(Mars)) {}
+      : landing_sites(MapInfo(game_state.gc.get_starting_planet(Mars))) {}
 
-  bool run(GameState &game_state, unordered_set<unsigned> rockets) {
+  bool run(GameState &game_state, const vector<unsigned> &rockets) {
     auto did_launch = false;
     for (const auto rocket_id : rockets) {
       // A rocket launch could have destroyed a surrounding rocket.
       if (!game_state.gc.has_unit(rocket_id)) continue;
 
-      const auto rocket_unit = game_state.gc.get_unit(rocket_id);
+      const auto &rocket_unit = game_state.get_unit(rocket_id);
 
-      if (!rocket_unit.structure_is_built()) continue;
+      if (!rocket_unit.is_built) continue;
 
       // Don't launch if insufficient units in garrison unless it's about to
       // flood - in which case launch all the things.
-      if (rocket_unit.get_structure_garrison().size() < MIN_UNITS_TO_LAUNCH &&
+      if (rocket_unit.garrison.size() < MIN_UNITS_TO_LAUNCH &&
           game_state.round < constants::FLOOD_ROUND - 1)
         continue;
 
-      const auto ml = mars_map_info.get_random_passable_location();
-      if (!game_state.gc.can_launch_rocket(rocket_id, ml)) continue;
+      Coord ml;
+      if (!landing_sites.get_best_site(ml)) continue;
+      if (!game_state.gc.can_launch_rocket(rocket_id, ml.to_map_location())) {
+        continue;
+      }
 
       game_state.launch(rocket_id, ml);
+      landing_sites.claim(ml.get_x(), ml.get_y());
       did_launch = true;
     }
     return did_launch;
@@ -600,6 +633,34 @@ class AttackStrategy : public RobotStrategy {
   const unsigned special_attack_range;
   const PairwiseDistances &distances;
 
+  // Weight of the distance to an enemy of a type, lower is more wanted.
+  static float enemy_score(UnitType enemy_type) {
+    float score = 1.;
+    switch (enemy_type) {
+      case Worker:
+        score *= 2;
+        break;
+      case Factory:
+        score *= 0.25;
+        break;
+      case Mage:
+        score *= 0.5;
+        break;
+      case Ranger:
+        score *= 0.5;
+        break;
+      case Knight:
+        score *= 0.5;
+        break;
+      case Healer:
+        score *= 0.6;
+        break;
+      default:
+        break;
+    }
+    return score;
+  }
+
  public:
   AttackStrategy(const UnitType unit_type, const PairwiseDistances &distances)
       : unit_type(unit_type),
@@ -607,67 +668,93 @@ class AttackStrategy : public RobotStrategy {
         special_attack_range(constants::SPECIAL_ATTACK_RANGE[unit_type]),
         distances(distances) {}
 
-  bool run(GameState &game_state, unordered_set<unsigned> military_units) {
-    vector<pair<MapLocation, float>> target_locations;
+  bool run(GameState &game_state, const vector<unsigned> &military_units) {
+    vector<pair<Coord, float>> target_locations;
 
     if (should_move_to_rockets) {
-      for (const auto &unit : game_state.my_units.by_id) {
-        const auto loc = unit.second.second;
-        if (unit.second.first == Rocket) {
-          target_locations.push_back(make_pair(loc, 0.1));
-        }
+      for (const auto rocket_id : game_state.my_units.of_type(Rocket)) {
+        const auto loc = game_state.my_units.get_location(rocket_id);
+        target_locations.push_back(make_pair(loc, 0.1));
       }
     }
 
-    for (const auto &unit : game_state.enemy_units.by_id) {
-      const auto loc = unit.second.second;
-      float score = 1.;
-      switch (unit.second.first) {
-        case Worker:
-          score *= 2;
-          break;
-        case Factory:
-          score *= 0.25;
-          break;
-        case Mage:
-          score *= 0.5;
-          break;
-        case Ranger:
-          score *= 0.5;
-          break;
-        case Knight:
-          score *= 0.5;
-          break;
-        case Healer:
-          score *= 0.6;
-          break;
-        default:
-          break;
-      }
-      target_locations.push_back(make_pair(loc, score));
+    const auto &enemies = game_state.enemy_units;
+    for (size_t slot = 0; slot < enemies.size(); slot++) {
+      const auto loc =
+          game_state.map_info.get_location(enemies.xs[slot], enemies.ys[slot]);
+      target_locations.push_back(
+          make_pair(loc, enemy_score(enemies.types[slot])));
     }
 
-    const auto targets = find_targets_with_weights(game_state, military_units,
-                                                   target_locations, distances);
+    // Enemies out of sight are chased too, after the ones in sight. One
+    // weight for every age keeps the number of distinct weights small.
+    const auto &memory = game_state.enemy_memory;
+    for (const auto &entry : memory.sightings) {
+      const auto &sighting = entry.second;
+      if (memory.is_visible(sighting)) continue;
+      const auto loc = game_state.map_info.get_location(sighting.x, sighting.y);
+      target_locations.push_back(
+          make_pair(loc, 2 * enemy_score(sighting.unit_type)));
+    }
 
-    unordered_map<uint16_t, unsigned> n_targetting;
+    // Units take their best target while it has room for up to 10 units,
+    // closest first, and the ones left over are assigned among the room that
+    // is left. Ranged units that are reloading under fire step back instead.
     unordered_set<unsigned> targetting;
+    const NearestTargetField nearest(distances, target_locations);
+    vector<int> room(target_locations.size(), 10);
+    TargetList by_cost;
+    for (const auto militant_id : military_units) {
+      if (maybe_retreat(game_state, militant_id)) {
+        targetting.insert(militant_id);
+        continue;
+      }
+      const auto loc = game_state.my_units.get_location(militant_id);
+      const auto x = loc.get_x();
+      const auto y = loc.get_y();
+      if (nearest.get_target(x, y) == -1) continue;
+      by_cost.add(nearest.get_cost(x, y), militant_id, x, y);
+    }
+
+    vector<Target> targets;
+    vector<unsigned> leftover_units;
+    Target unit;
+    while (by_cost.next(unit)) {
+      const auto best = nearest.get_target(unit.x, unit.y);
+      if (room[best] == 0) {
+        leftover_units.push_back(unit.id);
+        continue;
+      }
+      room[best]--;
+      const auto &loc = target_locations[best].first;
+      targets.push_back({unit.distance, unit.id,
+                         static_cast<uint8_t>(loc.get_x()),
+                         static_cast<uint8_t>(loc.get_y())});
+    }
+
+    if (!leftover_units.empty()) {
+      vector<AssignmentTarget> assignment_targets;
+      for (int i = 0; i < (int)target_locations.size(); i++) {
+        assignment_targets.push_back(AssignmentTarget(
+            target_locations[i].first, target_locations[i].second, room[i]));
+      }
+      const auto leftover_targets = assign_targets(
+          game_state, leftover_units, assignment_targets, distances);
+      targets.insert(targets.end(), leftover_targets.begin(),
+                     leftover_targets.end());
+    }
 
-    // Move towards target.
-    for (const auto &target : targets) {
-      if (target.distance == numeric_limits<uint16_t>::max()) continue;
-
-      const uint16_t hash = (target.x << 8) + target.y;
-      if (n_targetting[hash] >= 10) continue;
-      if (targetting.count(target.id)) continue;
+    ReservationTable reservations(game_state.map_info.width,
+                                  game_state.map_info.height);
 
+    // Move towards target, closest units first.
+    for (const auto &target : targets) {
       const auto goal = game_state.map_info.get_location(target.x, target.y);
-
-      n_targetting[hash]++;
       targetting.insert(target.id);
 
-      maybe_move(game_state, target.id, goal, distances);
+      reservations.add(target.id, goal, distances);
     }
+    reservations.execute(game_state);
 
     // Attack nearby targets.
     for (const auto militant_id : military_units) {
@@ -675,47 +762,70 @@ class AttackStrategy : public RobotStrategy {
         maybe_move_randomly(game_state, militant_id);
       }
 
-      const auto loc = game_state.my_units.by_id[militant_id].second;
+      const auto loc = game_state.my_units.get_location(militant_id);
+      const auto x = loc.get_x();
+      const auto y = loc.get_y();
+      const auto &enemies = game_state.enemy_units;
+      const auto by_attack_score = [&](unsigned enemy_id) {
+        return attack_score(enemies, enemy_id);
+      };
 
       if (game_state.can_special_attack(unit_type)) {
-        auto enemies_within_special_range =
-            game_state.gc.sense_nearby_units_by_team(loc, special_attack_range,
-                                                     game_state.ENEMY_TEAM);
-        sort(enemies_within_special_range.begin(),
-             enemies_within_special_range.end(),
-             [](const auto &a, const auto &b) {
-               return attack_score(a) < attack_score(b);
-             });
-
-        for (const Unit &enemy : enemies_within_special_range) {
-          const auto enemy_id = enemy.get_id();
+        const auto enemies_within_special_range = enemies.find_within_sorted(
+            x, y, special_attack_range, by_attack_score);
+
+        for (const auto enemy_id : enemies_within_special_range) {
           game_state.special_attack(militant_id, unit_type, enemy_id);
         }
       }
 
-      auto enemies_within_range = game_state.gc.sense_nearby_units_by_team(
-          loc, attack_range, game_state.ENEMY_TEAM);
-      sort(enemies_within_range.begin(), enemies_within_range.end(),
-           [](const auto &a, const auto &b) {
-             return attack_score(a) < attack_score(b);
-           });
-
-      for (const Unit &enemy : enemies_within_range) {
-        const auto enemy_id = enemy.get_id();
-        if (game_state.gc.is_attack_ready(militant_id) &&
-            game_state.gc.can_attack(militant_id, enemy_id)) {
+      const auto enemies_within_range =
+          enemies.find_within_sorted(x, y, attack_range, by_attack_score);
+
+      for (const auto enemy_id : enemies_within_range) {
+        if (game_state.is_attack_ready(militant_id) &&
+            game_state.can_attack(militant_id, enemy_id)) {
           game_state.attack(militant_id, enemy_id);
         }
       }
     }
 
-    return game_state.enemy_units.all.size() == 0;
+    return game_state.enemy_units.size() == 0;
   }
 
  protected:
-  static double attack_score(const Unit &unit) {
-    auto score = unit.get_health();
-    switch (unit.get_unit_type()) {
+  // Moves a unit that can't shoot this turn to the neighbouring cell the
+  // enemies could deal the least damage to, if that is less than where it
+  // stands. Knights have to close in to attack at all, so they never do.
+  bool maybe_retreat(GameState &game_state, unsigned unit_id) {
+    if (attack_range <= constants::ATTACK_RANGE[Knight]) return false;
+    if (game_state.is_attack_ready(unit_id)) return false;
+    if (!game_state.is_move_ready(unit_id)) return false;
+
+    const auto &threat_map = game_state.threat_map;
+    const auto x = game_state.my_units.get_x(unit_id);
+    const auto y = game_state.my_units.get_y(unit_id);
+    auto best_damage = threat_map.get_damage(x, y);
+    auto best_dir = Center;
+    for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
+      const auto dir = static_cast<Direction>(i);
+      const auto next_x = x + constants::DX[i];
+      const auto next_y = y + constants::DY[i];
+      if (!game_state.map_info.is_valid_location(next_x, next_y)) continue;
+      if (threat_map.get_damage(next_x, next_y) >= best_damage) continue;
+      if (!game_state.can_move(unit_id, dir)) continue;
+      best_damage = threat_map.get_damage(next_x, next_y);
+      best_dir = dir;
+    }
+    if (best_dir == Center) return false;
+
+    game_state.move(unit_id, best_dir);
+    return true;
+  }
+
+  static double attack_score(const UnitList &units, unsigned id) {
+    auto score = units.get_health(id).current;
+    switch (units.get_type(id)) {
       case Worker:
         score *= 3;
         break;
@@ -749,18 +859,20 @@ class HealingStrategy : public RobotStrategy {
  public:
   HealingStrategy(const PairwiseDistances &distances) : distances(distances) {}
 
-  bool run(GameState &game_state, unordered_set<unsigned> healers) {
-    vector<pair<MapLocation, float>> target_locations;
+  bool run(GameState &game_state, const vector<unsigned> &healers) {
+    vector<pair<Coord, float>> target_locations;
 
-    for (const auto &unit : game_state.my_units.by_id) {
+    const auto &my_units = game_state.my_units;
+    for (size_t slot = 0; slot < my_units.size(); slot++) {
       // We don't want healers to target themselves or eachother, otherwise
       // they can just ignore other units and clump together since we're
       // sorting by distance.
-      if (unit.second.first == Healer) continue;
-      if (unit.second.first == Factory) continue;
+      const auto unit_type = my_units.types[slot];
+      if (unit_type == Healer) continue;
+      if (unit_type == Factory) continue;
 
       float score = 1.;
-      switch (unit.second.first) {
+      switch (unit_type) {
         case Worker:
           score *= 10;
           break;
@@ -783,31 +895,32 @@ class HealingStrategy : public RobotStrategy {
           break;
       }
 
-      const auto loc = unit.second.second;
+      const auto loc = game_state.map_info.get_location(my_units.xs[slot],
+                                                        my_units.ys[slot]);
       target_locations.push_back(make_pair(loc, score));
     }
 
-    const auto targets = find_targets_with_weights(game_state, healers,
-                                                   target_locations, distances);
+    vector<AssignmentTarget> assignment_targets;
+    for (const auto &target_location : target_locations) {
+      assignment_targets.push_back(AssignmentTarget(
+          target_location.first, target_location.second, 1));
+    }
+
+    const auto targets =
+        assign_targets(game_state, healers, assignment_targets, distances);
 
-    unordered_map<uint16_t, unsigned> n_targetting;
     unordered_set<unsigned> targetting;
+    ReservationTable reservations(game_state.map_info.width,
+                                  game_state.map_info.height);
 
-    // Move towards target.
+    // Move towards target, closest units first.
     for (const auto &target : targets) {
-      if (target.distance == numeric_limits<uint16_t>::max()) continue;
-
-      const uint16_t hash = (target.x << 8) + target.y;
-      if (n_targetting[hash] >= 1) continue;
-      if (targetting.count(target.id)) continue;
-
       const auto goal = game_state.map_info.get_location(target.x, target.y);
-
-      n_targetting[hash]++;
       targetting.insert(target.id);
 
-      maybe_move(game_state, target.id, goal, distances);
+      reservations.add(target.id, goal, distances);
     }
+    reservations.execute(game_state);
 
     // Heal nearby targets.
     unordered_set<unsigned> has_been_overcharged;
@@ -816,38 +929,36 @@ class HealingStrategy : public RobotStrategy {
         maybe_move_randomly(game_state, healer_id);
       }
 
-      const auto loc = game_state.my_units.by_id[healer_id].second;
-      auto my_units_within_range = game_state.gc.sense_nearby_units_by_team(
-          loc, healing_range, game_state.MY_TEAM);
-
-      sort(my_units_within_range.begin(), my_units_within_range.end(),
-           [](const auto &a, const auto &b) {
-             // Heal lowest health first.
-             return a.get_health() / (double)a.get_max_health() <
-                    b.get_health() / (double)b.get_max_health();
-           });
-
-      for (const Unit &unit : my_units_within_range) {
-        const auto unit_id = unit.get_id();
-        if (unit.get_health() == unit.get_max_health()) continue;
-
-        if (game_state.gc.is_heal_ready(healer_id) &&
-            game_state.gc.can_heal(healer_id, unit_id)) {
-          game_state.gc.heal(healer_id, unit_id);
+      const auto loc = game_state.my_units.get_location(healer_id);
+      const auto x = loc.get_x();
+      const auto y = loc.get_y();
+      const auto &my_units = game_state.my_units;
+
+      // Heal lowest health first.
+      const auto my_units_within_range = my_units.find_within_sorted(
+          x, y, healing_range, [&](unsigned unit_id) {
+            const auto health = my_units.get_health(unit_id);
+            return health.current / (double)health.max;
+          });
+
+      for (const auto unit_id : my_units_within_range) {
+        const auto health = my_units.get_health(unit_id);
+        if (health.current == health.max) continue;
+
+        if (game_state.is_heal_ready(healer_id) &&
+            game_state.can_heal(healer_id, unit_id)) {
+          game_state.heal(healer_id, unit_id);
           break;
         }
       }
 
       if (game_state.gc.is_overcharge_ready(healer_id)) {
-        auto my_units_within_range = game_state.gc.sense_nearby_units_by_team(
-            loc, overcharge_range, game_state.MY_TEAM);
-        sort(my_units_within_range.begin(), my_units_within_range.end(),
-             [](const auto &a, const auto &b) {
-               return overcharge_score(a) < overcharge_score(b);
-             });
-
-        for (const Unit &unit : my_units_within_range) {
-          const auto unit_id = unit.get_id();
+        const auto my_units_within_range = my_units.find_within_sorted(
+            x, y, overcharge_range, [&](unsigned unit_id) {
+              return overcharge_score(game_state, unit_id);
+            });
+
+        for (const auto unit_id : my_units_within_range) {
           if (has_been_overcharged.count(unit_id)) continue;
           if (game_state.special_attack(healer_id, Healer, unit_id)) {
             has_been_overcharged.insert(unit_id);
@@ -861,11 +972,12 @@ class HealingStrategy : public RobotStrategy {
   }
 
  protected:
-  static double overcharge_score(const Unit &unit) {
-    if (unit.is_structure()) return 1000;
+  static double overcharge_score(GameState &game_state, unsigned id) {
+    const auto unit_type = game_state.my_units.get_type(id);
+    if (unit_type == Factory || unit_type == Rocket) return 1000;
 
-    float score = 30 - unit.get_attack_cooldown();
-    switch (unit.get_unit_type()) {
+    float score = 30 - game_state.get_unit(id).attack_cooldown;
+    switch (unit_type) {
       case Ranger:
         score *= 0.5;
         break;
@@ -892,7 +1004,7 @@ class UnitProductionStrategy : public Strategy {
  public:
   UnitProductionStrategy(UnitType unit_type) : unit_type(unit_type) {}
 
-  bool run(GameState &game_state, unordered_set<unsigned> factories) {
+  bool run(GameState &game_state, const vector<unsigned> &factories) {
     for (const auto factory_id : factories) {
       if (game_state.gc.can_produce_robot(factory_id, unit_type)) {
         game_state.produce(factory_id, unit_type);
@@ -1,12 +1,8 @@
 #pragma once
 
-#include <algorithm>
-#include <limits>
-#include <unordered_set>
+#include <cstdint>
 #include <vector>
 
-#include "GameState.hpp"
-#include "PairwiseDistances.hpp"
 #include "bc.hpp"
 
 using namespace bc;
@@ -19,66 +15,38 @@ struct Target {
   uint8_t y;
 };
 
-vector<Target> find_targets(GameState &game_state,
-                            unordered_set<unsigned> units,
-                            vector<MapLocation> target_locations,
-                            const PairwiseDistances &distances) {
-  vector<Target> targets;
-  for (const auto unit_id : units) {
-    const auto unit_loc = game_state.my_units.by_id[unit_id].second;
-    const auto unit_x = unit_loc.get_x();
-    const auto unit_y = unit_loc.get_y();
-
-    for (const auto &target_loc : target_locations) {
-      const auto target_x = target_loc.get_x();
-      const auto target_y = target_loc.get_y();
-
-      float distance =
-          distances.get_distance(unit_x, unit_y, target_x, target_y);
+// Targets handed out cheapest first. Each one is keyed by its distance,
+// quantised to 1 / QUANTUM, packed with its index, and the keys are bucket
+// sorted on the first call to next(). A bucket is only ordered once reached,
+// so callers that stop early don't pay for ordering the rest. Targets with the
+// same key come out in the order they were added.
+class TargetList {
+ public:
+  constexpr static float QUANTUM = 16;
 
-      Target curr_target{distance, unit_id, static_cast<uint8_t>(target_x),
-                         static_cast<uint8_t>(target_y)};
-      targets.push_back(curr_target);
-    }
-  }
+  void clear();
+  void add(float distance, uint32_t id, uint8_t x, uint8_t y);
 
-  // Sort by distance.
-  sort(targets.begin(), targets.end(), [](const auto &a, const auto &b) {
-    return !(a.distance >= b.distance);
-  });
+  inline size_t size() const { return targets.size(); }
+  inline const Target &operator[](int index) const { return targets[index]; }
 
-  return targets;
-}
+  // Index, in order of addition, of the next target, or -1 once all of them
+  // were handed out.
+  int next_index();
+  bool next(Target &target);
 
-vector<Target> find_targets_with_weights(
-    GameState &game_state, unordered_set<unsigned> units,
-    vector<pair<MapLocation, float>> target_locations,
-    const PairwiseDistances &distances) {
+ private:
   vector<Target> targets;
-  for (const auto unit_id : units) {
-    const auto unit_loc = game_state.my_units.by_id[unit_id].second;
-    const auto unit_x = unit_loc.get_x();
-    const auto unit_y = unit_loc.get_y();
-
-    for (const auto &target_loc_pair : target_locations) {
-      const auto target_loc = target_loc_pair.first;
-      const auto weight = target_loc_pair.second;
-      const auto target_x = target_loc.get_x();
-      const auto target_y = target_loc.get_y();
-
-      float distance =
-          weight * distances.get_distance(unit_x, unit_y, target_x, target_y);
-
-      Target curr_target{distance, unit_id, static_cast<uint8_t>(target_x),
-                         static_cast<uint8_t>(target_y)};
-      targets.push_back(curr_target);
-    }
-  }
-
-  // Sort by distance.
-  sort(targets.begin(), targets.end(), [](const auto &a, const auto &b) {
-    return !(a.distance >= b.distance);
-  });
-
-  return targets;
-}
+  vector<uint64_t> keys;
+  uint64_t max_quantised = 0;
+
+  // Keys grouped by bucket, in order up to `ordered_end`.
+  vector<uint64_t> bucketed;
+  vector<int> bucket_end;
+  int bucket;
+  size_t cursor;
+  size_t ordered_end;
+  bool is_bucketed = false;
+
+  void distribute();
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "EnemyMemory.hpp"
+#include "constants.hpp"
+
+using namespace std;
+
+// Damage the enemies could deal to each cell with one attack each, stamped
+// once per turn from their attack kernels.
+struct ThreatMap {
+  // Remembered enemies count for this many rounds after they were last seen.
+  constexpr static uint32_t MAX_AGE = 5;
+
+  const int width;
+  const int height;
+
+  ThreatMap(int width, int height);
+
+  void update(const EnemyMemory &memory);
+
+  inline unsigned get_damage(int x, int y) const {
+    return damage[x * height + y];
+  }
+
+ private:
+  // Cells [y + lo, y + hi] of column x + dx are in reach of a unit at (x, y).
+  struct Run {
+    int dx;
+    int lo;
+    int hi;
+  };
+
+  // Runs of constants::KERNEL for each unit type that attacks.
+  array<vector<Run>, constants::N_UNIT_TYPES> runs;
+
+  // Convention: [x * (height + 1) + y]. Damage starting minus damage ending
+  // at each cell of a column, summed up into `damage`.
+  vector<int> starts;
+  vector<unsigned> damage;
+
+  void stamp(UnitType unit_type, int x, int y);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "bc.hpp"
+
+using namespace std;
+using namespace bc;
+
+// Fields of a unit, read from the game in one go.
+struct UnitSnapshot {
+  UnitType unit_type;
+  unsigned health;
+  unsigned max_health;
+
+  // Robots only.
+  unsigned movement_heat;
+  unsigned attack_heat;
+  unsigned attack_cooldown;
+  unsigned ability_heat;
+
+  // Workers only.
+  bool has_acted;
+
+  // Structures only.
+  bool is_built;
+  vector<unsigned> garrison;
+};
+
+// Snapshots of units, each fetched the first time it is asked for. Actions
+// that change a unit must invalidate it, and the cache is cleared every turn,
+// so that every unit is fetched at most once per turn and action.
+struct UnitCache {
+  // Valid until `id` is invalidated or the cache is cleared.
+  const UnitSnapshot &get(GameController &gc, unsigned id);
+
+  void invalidate(unsigned id);
+  void clear();
+
+ private:
+  unordered_map<unsigned, UnitSnapshot> snapshots;
+};
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <unordered_map>
-#include <unordered_set>
+#include <cstdint>
 #include <vector>
 
+#include "BitGrid.hpp"
+#include "Coord.hpp"
 #include "bc.hpp"
 #include "constants.hpp"
 
@@ -12,26 +15,169 @@ using namespace bc;
 using namespace std;
 
 struct UnitList {
+  struct Health {
+    unsigned current;
+    unsigned max;
+  };
+
+  // Bits of `flags`.
+  enum Flag : uint8_t {
+    // Health was read from the unit this turn, rather than assumed.
+    SENSED = 1,
+  };
+
+  // Ids of a list of slots, iterated without copying. Adding or removing
+  // units invalidates it, so loops that do take a copy with get_ids().
+  class View {
+   public:
+    class iterator {
+     public:
+      iterator(const unsigned* ids, const int* slot) : ids(ids), slot(slot) {}
+      inline unsigned operator*() const { return ids[*slot]; }
+      inline iterator& operator++() {
+        ++slot;
+        return *this;
+      }
+      inline bool operator!=(const iterator& other) const {
+        return slot != other.slot;
+      }
+
+     private:
+      const unsigned* ids;
+      const int* slot;
+    };
+
+    View(const vector<unsigned>& ids, const vector<int>& slots)
+        : ids(ids), slots(slots) {}
+
+    inline iterator begin() const {
+      return iterator(ids.data(), slots.data());
+    }
+    inline iterator end() const {
+      return iterator(ids.data(), slots.data() + slots.size());
+    }
+    inline size_t size() const { return slots.size(); }
+    inline bool empty() const { return slots.empty(); }
+
+   private:
+    const vector<unsigned>& ids;
+    const vector<int>& slots;
+  };
+
   const Team TEAM;
   const Planet PLANET;
   const unsigned WIDTH;
   const unsigned HEIGHT;
 
-  array<unordered_set<unsigned>, constants::N_UNIT_TYPES> by_type;
-  unordered_map<unsigned, pair<UnitType, MapLocation>> by_id;
-  vector<vector<unsigned>> by_location;
-  vector<vector<bool>> is_occupied;
-  unordered_set<unsigned> all;
+  // One entry per unit, indexed by slot. Slots are dense: removing a unit
+  // moves the last one into its slot. Only change them through add(),
+  // remove() and move().
+  vector<unsigned> ids;
+  vector<UnitType> types;
+  vector<uint8_t> xs;
+  vector<uint8_t> ys;
+  vector<Health> healths;
+  vector<uint8_t> flags;
+
+  // Slots of the units of each type, and the index of each slot in the list
+  // of its type.
+  array<vector<int>, constants::N_UNIT_TYPES> type_slots;
+  vector<int> type_index;
+
+  unordered_map<unsigned, int> slot_of_id;
 
-  unordered_map<unsigned, MapLocation> initial_workers;
+  // Unit on each cell, indexed by [x * HEIGHT + y], only meaningful where
+  // `occupied` is set.
+  vector<unsigned> by_location;
+  BitGrid occupied;
+
+  unordered_map<unsigned, Coord> initial_workers;
 
   UnitList(GameController& gc, const Team& team);
 
-  void add(unsigned id, UnitType unit_type, MapLocation loc);
+  void add(unsigned id, UnitType unit_type, int x, int y);
+  void add(unsigned id, UnitType unit_type, const Coord& loc);
 
   void remove(unsigned id);
 
   void move(unsigned id, Direction dir);
 
-  void update(GameController& gc);
+  // Fills `a` and `b`, one list per team, in one pass over get_units().
+  static void update(GameController& gc, UnitList& a, UnitList& b);
+
+  // The same for this list alone, probing every cell of the map. Several
+  // times slower, only kept to benchmark update() against.
+  void update_by_probing(GameController& gc);
+
+  inline bool is_occupied(int x, int y) const { return occupied.test(x, y); }
+  inline unsigned get_id_at(int x, int y) const {
+    return by_location[x * HEIGHT + y];
+  }
+
+  inline size_t size() const { return ids.size(); }
+  inline size_t count(UnitType unit_type) const {
+    return type_slots[unit_type].size();
+  }
+  inline bool contains(unsigned id) const { return slot_of_id.count(id); }
+
+  inline int get_slot(unsigned id) const { return slot_of_id.at(id); }
+  inline UnitType get_type(unsigned id) const { return types[get_slot(id)]; }
+  inline int get_x(unsigned id) const { return xs[get_slot(id)]; }
+  inline int get_y(unsigned id) const { return ys[get_slot(id)]; }
+  inline Coord get_location(unsigned id) const {
+    const auto slot = get_slot(id);
+    return Coord(PLANET, xs[slot], ys[slot]);
+  }
+
+  inline bool is_sensed(unsigned id) const {
+    return flags[get_slot(id)] & SENSED;
+  }
+
+  // Units that weren't sensed this turn, like ones added during it, read as
+  // healthy.
+  inline Health get_health(unsigned id) const {
+    const auto slot = get_slot(id);
+    return flags[slot] & SENSED ? healths[slot] : Health{1, 1};
+  }
+  inline void set_health(unsigned id, unsigned health) {
+    healths[get_slot(id)].current = health;
+  }
+
+  inline View of_type(UnitType unit_type) const {
+    return View(ids, type_slots[unit_type]);
+  }
+
+  // Copies, to iterate over while units come and go.
+  inline vector<unsigned> get_ids() const { return ids; }
+  vector<unsigned> get_ids(UnitType unit_type) const;
+
+  // Ids of the units within `radius_squared` of (x, y), like
+  // sense_nearby_units_by_team but without going through the API. Only the
+  // occupied cells of each row are looked at.
+  void find_within(int x, int y, unsigned radius_squared,
+                   vector<unsigned>& found) const;
+
+  // Same, in increasing order of `score(id)`.
+  template <typename Score>
+  vector<unsigned> find_within_sorted(int x, int y, unsigned radius_squared,
+                                      Score score) const {
+    vector<unsigned> found;
+    find_within(x, y, radius_squared, found);
+    vector<pair<double, unsigned>> scored;
+    for (const auto id : found) {
+      scored.push_back(make_pair(score(id), id));
+    }
+    sort(scored.begin(), scored.end());
+    for (int i = 0; i < (int)found.size(); i++) {
+      found[i] = scored[i].second;
+    }
+    return found;
+  }
+
+ private:
+  // Forgets every unit, before the ones sensed this turn are added back.
+  void clear();
+  void add_sensed(const Unit& unit, const MapLocation& loc);
+  // Adds the initial units that haven't been seen yet.
+  void add_unseen_initial_units();
 };
@@ -1,50 +1,28 @@
 #pragma once
 
-#include <algorithm>
-#include <utility>
-#include <vector>
-
 #include "GameState.hpp"
 #include "PairwiseDistances.hpp"
 
 #include "bc.hpp"
 #include "constants.hpp"
 
-// TODO: make some kind of GameState object that I can pass easily
-Direction silly_pathfinding(GameState &game_state, const MapLocation &start,
-                            const MapLocation &goal,
-                            const PairwiseDistances &pd) {
-  int unit_x = start.get_x();
-  int unit_y = start.get_y();
-
-  const auto x = goal.get_x();
-  const auto y = goal.get_y();
-
-  // Used to sort by distance and then by random
-  vector<pair<pair<unsigned short, int>, int>> v;
-  for (int k = 0; k < constants::N_DIRECTIONS; k++) {
-    const auto xx = unit_x + constants::DX[k];
-    const auto yy = unit_y + constants::DY[k];
-    v.push_back(make_pair(make_pair(pd.get_distance(xx, yy, x, y), rand()), k));
-  }
-
-  const auto current_distance = v[Center].first.first;
-  sort(v.begin(), v.end());
-
-  for (int i = 0; i < constants::N_DIRECTIONS; i++) {
-    const auto next_distance = v[i].first.first;
-    if (next_distance > current_distance) continue;
-
-    const auto k = v[i].second;
-    const auto xx = unit_x + constants::DX[k];
-    const auto yy = unit_y + constants::DY[k];
-
-    if (!game_state.map_info.is_valid_location(xx, yy)) continue;
-    if (!game_state.map_info.can_sense[xx][yy]) continue;
-    if (!game_state.map_info.passable_terrain[xx][yy]) continue;
+// First free step from `start` towards `goal`, looked up in the flow field of
+// the goal, shared by every unit heading there this turn.
+inline Direction flow_pathfinding(GameState &game_state, const Coord &start,
+                                  const Coord &goal,
+                                  const PairwiseDistances &pd) {
+  const auto unit_x = start.get_x();
+  const auto unit_y = start.get_y();
+
+  const auto moves = game_state.flow_fields.get_moves(
+      game_state.map_info, pd, unit_x, unit_y, goal.get_x(), goal.get_y());
+  for (int i = 0; i < moves.size(); i++) {
+    const auto dir = moves[i];
+    const auto xx = unit_x + constants::DX[dir];
+    const auto yy = unit_y + constants::DY[dir];
     if (game_state.has_unit_at(xx, yy)) continue;
 
-    return static_cast<Direction>(k);
+    return dir;
   }
 
   return Center;
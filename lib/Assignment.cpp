@@ -0,0 +1,198 @@
+#include "Assignment.hpp"
+#include <algorithm>
+#include <queue>
+
+using namespace bc;
+using namespace std;
+
+namespace {
+
+// Targets each unit considers.
+constexpr int MAX_CANDIDATES = 8;
+
+struct Candidate {
+  float cost;
+  int target;
+};
+
+}  // namespace
+
+vector<Target> assign_targets(GameState &game_state,
+                              const vector<unsigned> &units,
+                              const vector<AssignmentTarget> &targets,
+                              const PairwiseDistances &distances) {
+  const auto &ids = units;
+  const int n_units = ids.size();
+  const int n_targets = targets.size();
+
+  vector<int> unit_x(n_units);
+  vector<int> unit_y(n_units);
+  for (int i = 0; i < n_units; i++) {
+    unit_x[i] = game_state.my_units.get_x(ids[i]);
+    unit_y[i] = game_state.my_units.get_y(ids[i]);
+  }
+
+  const auto get_cost = [&](int unit, int target) {
+    const auto distance = distances.get_distance(
+        unit_x[unit], unit_y[unit], targets[target].x, targets[target].y);
+    if (distance == PairwiseDistances::UNREACHABLE) {
+      return numeric_limits<float>::infinity();
+    }
+    const auto cost = targets[target].weight * distance;
+    if (cost > targets[target].max_cost) {
+      return numeric_limits<float>::infinity();
+    }
+    return cost;
+  };
+
+  // Cheapest targets of unit i, in [i * MAX_CANDIDATES, + n_candidates[i]).
+  vector<Candidate> candidates(n_units * MAX_CANDIDATES);
+  vector<int> n_candidates(n_units);
+  TargetList list;
+  vector<int> target_of_entry;
+  for (int i = 0; i < n_units; i++) {
+    list.clear();
+    target_of_entry.clear();
+    for (int j = 0; j < n_targets; j++) {
+      if (targets[j].capacity <= 0) continue;
+      const auto cost = get_cost(i, j);
+      if (cost == numeric_limits<float>::infinity()) continue;
+      list.add(cost, ids[i], targets[j].x, targets[j].y);
+      target_of_entry.push_back(j);
+    }
+
+    auto &n = n_candidates[i];
+    for (int entry; n < MAX_CANDIDATES && (entry = list.next_index()) != -1;) {
+      candidates[i * MAX_CANDIDATES + n++] = {list[entry].distance,
+                                              target_of_entry[entry]};
+    }
+  }
+
+  // Min-cost flow by successive shortest paths, from a source to every unit,
+  // from units to their candidates and from targets to a sink, with room for
+  // `capacity` units. Each round moves one more unit in along the cheapest
+  // path, which may send assigned units elsewhere on the way. Nodes are the
+  // units, then the targets, then the source and the sink.
+  const int source = n_units + n_targets;
+  const int sink = source + 1;
+  const int n_nodes = sink + 1;
+
+  vector<int> target_of_unit(n_units, -1);
+  vector<float> cost_of_unit(n_units);
+  vector<vector<int>> units_of_target(n_targets);
+
+  // Johnson potentials keep the reduced costs of the residual edges
+  // non-negative, so that Dijkstra applies.
+  vector<double> potential(n_nodes);
+  vector<double> distance(n_nodes);
+  vector<int> parent(n_nodes);
+  vector<float> parent_cost(n_nodes);
+  typedef pair<double, int> Entry;
+
+  for (int round = 0; round < n_units; round++) {
+    fill(distance.begin(), distance.end(), numeric_limits<double>::infinity());
+    priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+    const auto relax = [&](int from, int to, double cost, float edge_cost) {
+      const auto d =
+          distance[from] + max(0., cost + potential[from] - potential[to]);
+      if (d < distance[to]) {
+        distance[to] = d;
+        parent[to] = from;
+        parent_cost[to] = edge_cost;
+        queue.push(Entry(d, to));
+      }
+    };
+
+    distance[source] = 0;
+    queue.push(Entry(0, source));
+    while (!queue.empty()) {
+      const auto entry = queue.top();
+      queue.pop();
+      const int v = entry.second;
+      if (entry.first > distance[v]) continue;
+      if (v == sink) break;
+
+      if (v == source) {
+        for (int i = 0; i < n_units; i++) {
+          if (target_of_unit[i] == -1 && n_candidates[i] > 0) {
+            relax(source, i, 0, 0);
+          }
+        }
+      } else if (v < n_units) {
+        for (int k = 0; k < n_candidates[v]; k++) {
+          const auto &candidate = candidates[v * MAX_CANDIDATES + k];
+          if (candidate.target == target_of_unit[v]) continue;
+          relax(v, n_units + candidate.target, candidate.cost, candidate.cost);
+        }
+      } else {
+        const int j = v - n_units;
+        for (const auto i : units_of_target[j]) {
+          relax(v, i, -cost_of_unit[i], 0);
+        }
+        if ((int)units_of_target[j].size() < targets[j].capacity) {
+          relax(v, sink, 0, 0);
+        }
+      }
+    }
+
+    if (distance[sink] == numeric_limits<double>::infinity()) break;
+
+    for (int v = 0; v < n_nodes; v++) {
+      potential[v] += min(distance[v], distance[sink]);
+    }
+
+    // Walk the path back, moving each unit on it to the next target.
+    for (int v = parent[sink]; v != source; v = parent[v]) {
+      const int from = parent[v];
+      if (v < n_units || from >= n_units) continue;
+
+      const int j = v - n_units;
+      const int i = from;
+      if (target_of_unit[i] != -1) {
+        auto &others = units_of_target[target_of_unit[i]];
+        others.erase(find(others.begin(), others.end(), i));
+      }
+      target_of_unit[i] = j;
+      cost_of_unit[i] = parent_cost[v];
+      units_of_target[j].push_back(i);
+    }
+  }
+
+  vector<int> remaining(n_targets);
+  for (int j = 0; j < n_targets; j++) {
+    remaining[j] = targets[j].capacity - (int)units_of_target[j].size();
+  }
+
+  vector<Target> result;
+  for (int i = 0; i < n_units; i++) {
+    const int j = target_of_unit[i];
+    if (j == -1) continue;
+    result.push_back({cost_of_unit[i], ids[i], targets[j].x, targets[j].y});
+  }
+
+  // Leftover units take the cheapest place left.
+  for (int i = 0; i < n_units; i++) {
+    if (target_of_unit[i] != -1 || n_candidates[i] == 0) continue;
+
+    auto best_cost = numeric_limits<float>::infinity();
+    int best_target = -1;
+    for (int j = 0; j < n_targets; j++) {
+      if (remaining[j] <= 0) continue;
+      const auto cost = get_cost(i, j);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_target = j;
+      }
+    }
+    if (best_target == -1) continue;
+
+    remaining[best_target]--;
+    result.push_back({best_cost, ids[i], targets[best_target].x,
+                      targets[best_target].y});
+  }
+
+  sort(result.begin(), result.end(), [](const Target &a, const Target &b) {
+    return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+  });
+  return result;
+}
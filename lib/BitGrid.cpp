@@ -0,0 +1,31 @@
+#include "BitGrid.hpp"
+#include <algorithm>
+
+using namespace std;
+
+BitGrid::BitGrid(int width, int height)
+    : width(width),
+      height(height),
+      rows(width + 2),
+      inside(((1ull << height) - 1) << 1) {}
+
+void BitGrid::clear() { fill(rows.begin(), rows.end(), 0); }
+
+int BitGrid::count_neighbours(int x, int y) const {
+  const auto around = span(y, 1);
+  const auto center = 1ull << (y + 1);
+  return __builtin_popcountll(row(x - 1) & around) +
+         __builtin_popcountll(row(x) & around & ~center) +
+         __builtin_popcountll(row(x + 1) & around);
+}
+
+bool BitGrid::any_within(int x, int y, int radius) const {
+  const auto around = span(y, radius);
+  const int x_lo = max(-1, x - radius);
+  const int x_hi = min(width, x + radius);
+  uint64_t any = 0;
+  for (int i = x_lo; i <= x_hi; i++) {
+    any |= row(i);
+  }
+  return any & around;
+}
@@ -0,0 +1,30 @@
+#include "EnemyMemory.hpp"
+
+using namespace bc;
+using namespace std;
+
+constexpr uint32_t EnemyMemory::MAX_AGE;
+
+void EnemyMemory::update(uint32_t current_round, const UnitList &enemies,
+                         const BitGrid &can_sense) {
+  round = current_round;
+
+  // Initial units that haven't been seen are guesses, not sightings.
+  for (size_t slot = 0; slot < enemies.size(); slot++) {
+    if (!(enemies.flags[slot] & UnitList::SENSED)) continue;
+    sightings[enemies.ids[slot]] = {enemies.types[slot], enemies.xs[slot],
+                                    enemies.ys[slot],
+                                    enemies.healths[slot].current, round};
+  }
+
+  for (auto it = sightings.begin(); it != sightings.end();) {
+    const auto &sighting = it->second;
+    const auto is_gone =
+        !is_visible(sighting) && can_sense.test(sighting.x, sighting.y);
+    if (is_gone || get_age(sighting) > MAX_AGE) {
+      it = sightings.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
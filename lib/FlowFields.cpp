@@ -0,0 +1,59 @@
+#include "FlowFields.hpp"
+#include <algorithm>
+#include "constants.hpp"
+
+using namespace bc;
+using namespace std;
+
+constexpr uint64_t FlowFields::NOT_COMPUTED;
+
+MoveList FlowFields::get_moves(const MapInfo &map_info,
+                               const PairwiseDistances &pd, int x, int y,
+                               int goal_x, int goal_y) {
+  auto &field = fields[make_pair(&pd, goal_x * map_info.height + goal_y)];
+  if (field.empty()) {
+    field.assign(map_info.width * map_info.height, NOT_COMPUTED);
+  }
+
+  auto &moves = field[x * map_info.height + y];
+  if (moves == NOT_COMPUTED) {
+    moves = compute_moves(map_info, pd, x, y, goal_x, goal_y).bits;
+  }
+  return MoveList{moves};
+}
+
+void FlowFields::clear() { fields.clear(); }
+
+MoveList FlowFields::compute_moves(const MapInfo &map_info,
+                                   const PairwiseDistances &pd, int x, int y,
+                                   int goal_x, int goal_y) {
+  const auto current_distance = pd.get_distance(x, y, goal_x, goal_y);
+  const auto offset = (3 * x + 5 * y) % constants::N_DIRECTIONS_WITHOUT_CENTER;
+
+  // (distance, tie-break, direction)
+  vector<pair<pair<unsigned short, int>, int>> candidates;
+  for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+    const auto xx = x + constants::DX[k];
+    const auto yy = y + constants::DY[k];
+
+    if (!map_info.is_valid_location(xx, yy)) continue;
+    if (!map_info.can_sense.test(xx, yy)) continue;
+    if (!map_info.passable_terrain[xx][yy]) continue;
+
+    const auto distance = pd.get_distance(xx, yy, goal_x, goal_y);
+    if (distance > current_distance) continue;
+    if (distance == current_distance && current_distance == 0) continue;
+
+    const auto tie_break =
+        (k - offset + constants::N_DIRECTIONS_WITHOUT_CENTER) %
+        constants::N_DIRECTIONS_WITHOUT_CENTER;
+    candidates.push_back(make_pair(make_pair(distance, tie_break), k));
+  }
+  sort(candidates.begin(), candidates.end());
+
+  uint64_t bits = candidates.size();
+  for (int i = 0; i < (int)candidates.size(); i++) {
+    bits |= (uint64_t)candidates[i].second << (4 + 4 * i);
+  }
+  return MoveList{bits};
+}
@@ -1,4 +1,6 @@
 #include "GameState.hpp"
+#include <ctime>
+#include <iostream>
 
 GameState::GameState(GameController &gc)
     : MY_TEAM(gc.get_team()),
@@ -9,87 +11,290 @@ GameState::GameState(GameController &gc)
       karbonite(gc.get_karbonite()),
       map_info(gc.get_starting_planet(PLANET)),
       my_units(gc, MY_TEAM),
-      enemy_units(gc, ENEMY_TEAM) {}
+      enemy_units(gc, ENEMY_TEAM),
+      threat_map(map_info.width, map_info.height),
+      is_blocked(map_info.width, map_info.height) {}
 
 void GameState::update() {
   round = gc.get_round();
+#ifdef CHECK_RULES
+  cout << "Rule mismatches: " << rule_mismatches << endl;
+  rule_mismatches = 0;
+#endif
   karbonite = gc.get_karbonite();
-  map_info.update(gc);
-  my_units.update(gc);
-  enemy_units.update(gc);
+#ifdef BENCHMARK
+  // The bulk update runs last, so that its lists are the ones used.
+  const auto probing_start = clock();
+  my_units.update_by_probing(gc);
+  enemy_units.update_by_probing(gc);
+  const auto bulk_start = clock();
+  UnitList::update(gc, my_units, enemy_units);
+  const auto bulk_stop = clock();
+  cout << "Unit update: probing "
+       << (bulk_start - probing_start) / double(CLOCKS_PER_SEC) * 1000
+       << " ms, bulk "
+       << (bulk_stop - bulk_start) / double(CLOCKS_PER_SEC) * 1000 << " ms"
+       << endl;
+#else
+  UnitList::update(gc, my_units, enemy_units);
+#endif
+  map_info.update(gc, my_units);
+  enemy_memory.update(round, enemy_units, map_info.can_sense);
+  threat_map.update(enemy_memory);
+  sync_blocked_cells();
+  flow_fields.clear();
+  unit_cache.clear();
 }
 
-bool GameState::is_surrounded(const MapLocation &loc) const {
-  const auto target_x = loc.get_x();
-  const auto target_y = loc.get_y();
+void GameState::add_distance_listener(PairwiseDistances& distances) {
+  distance_listeners.push_back(&distances);
+  for (int x = 0; x < map_info.width; x++) {
+    for (int y = 0; y < map_info.height; y++) {
+      if (is_blocked.test(x, y)) distances.block(x, y);
+    }
+  }
+}
 
-  for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
-    const auto x = target_x + constants::DX[i];
-    const auto y = target_y + constants::DY[i];
+void GameState::block_cell(int x, int y) {
+  if (is_blocked.test(x, y)) return;
+  is_blocked.set(x, y);
+  for (auto distances : distance_listeners) distances->block(x, y);
+}
 
-    if (!map_info.is_valid_location(x, y)) continue;
+void GameState::unblock_cell(int x, int y) {
+  if (!is_blocked.test(x, y)) return;
+  is_blocked.reset(x, y);
+  for (auto distances : distance_listeners) distances->unblock(x, y);
+}
 
-    if (!map_info.passable_terrain[x][y]) continue;
+void GameState::sync_blocked_cells() {
+  const auto is_structure_at = [](const UnitList& units, int x, int y) {
+    if (!units.is_occupied(x, y)) return false;
+    const auto unit_type = units.get_type(units.get_id_at(x, y));
+    return unit_type == Factory || unit_type == Rocket;
+  };
+
+  // Structures out of sight are assumed to still stand.
+  for (int x = 0; x < map_info.width; x++) {
+    for (int y = 0; y < map_info.height; y++) {
+      if (is_structure_at(my_units, x, y) ||
+          is_structure_at(enemy_units, x, y)) {
+        block_cell(x, y);
+      } else if (map_info.can_sense.test(x, y)) {
+        unblock_cell(x, y);
+      }
+    }
+  }
+}
 
-    if (!has_unit_at(map_info.get_location(x, y))) return false;
+bool GameState::is_surrounded(const Coord &loc) const {
+  const int x = loc.get_x();
+  const int y = loc.get_y();
+
+  // Free passable cells among the neighbours, a row at a time.
+  const auto around = BitGrid::span(y, 1);
+  const auto center = 1ull << (y + 1);
+  for (int i = x - 1; i <= x + 1; i++) {
+    const auto taken = my_units.occupied.row(i) | enemy_units.occupied.row(i);
+    auto free = map_info.passable.row(i) & ~taken & around;
+    if (i == x) free &= ~center;
+    if (free) return false;
   }
 
   return true;
 }
 
-bool GameState::is_surrounding_enemy(const MapLocation &loc) const {
-  const auto target_x = loc.get_x();
-  const auto target_y = loc.get_y();
+bool GameState::is_surrounding_enemy(const Coord &loc) const {
+  return enemy_units.occupied.count_neighbours(loc.get_x(), loc.get_y()) > 0;
+}
 
-  for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
-    const auto x = target_x + constants::DX[i];
-    const auto y = target_y + constants::DY[i];
+unsigned GameState::count_obstructions(unsigned x, unsigned y) const {
+  return enemy_units.occupied.count_neighbours(x, y) +
+         map_info.impassable.count_neighbours(x, y);
+}
 
-    if (!map_info.is_valid_location(x, y)) continue;
+bool GameState::is_free(int x, int y) const {
+  if (!map_info.is_valid_location(x, y)) return false;
+  if (!map_info.passable_terrain[x][y]) return false;
+  if (my_units.is_occupied(x, y)) return false;
+  // Initial enemies that were never seen may not be there.
+  return !enemy_units.is_occupied(x, y) ||
+         !enemy_units.is_sensed(enemy_units.get_id_at(x, y));
+}
 
-    if (enemy_units.is_occupied[x][y]) return true;
+int GameState::distance_squared(unsigned id, unsigned other_id) const {
+  int other_x, other_y;
+  if (my_units.contains(other_id)) {
+    other_x = my_units.get_x(other_id);
+    other_y = my_units.get_y(other_id);
+  } else if (enemy_units.contains(other_id) &&
+             enemy_units.is_sensed(other_id)) {
+    other_x = enemy_units.get_x(other_id);
+    other_y = enemy_units.get_y(other_id);
+  } else {
+    return -1;
   }
+  const auto dx = my_units.get_x(id) - other_x;
+  const auto dy = my_units.get_y(id) - other_y;
+  return dx * dx + dy * dy;
+}
 
-  return false;
+bool GameState::can_move(unsigned id, Direction dir) const {
+  const auto engine_answer = [&] { return gc.can_move(id, dir); };
+  if (!my_units.contains(id)) return engine_answer();
+
+  const auto loc = my_units.get_location(id).add(dir);
+  if (!is_known(loc.get_x(), loc.get_y())) return engine_answer();
+  const auto answer = !is_structure(my_units.get_type(id)) &&
+                      is_free(loc.get_x(), loc.get_y());
+  return check_rule(answer, engine_answer);
 }
 
-unsigned GameState::count_obstructions(unsigned x, unsigned y) const {
-  unsigned obstructions = 0;
-  for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
-    const auto probe_x = x + constants::DX[i];
-    const auto probe_y = y + constants::DY[i];
+bool GameState::is_move_ready(unsigned id) const {
+  const auto &unit = get_unit(id);
+  const auto answer =
+      !is_structure(unit.unit_type) && unit.movement_heat < constants::MAX_HEAT;
+  return check_rule(answer, [&] { return gc.is_move_ready(id); });
+}
 
-    if (!map_info.is_valid_location(probe_x, probe_y)) continue;
-    if (enemy_units.is_occupied[probe_x][probe_y]) obstructions++;
-    if (!map_info.passable_terrain[probe_x][probe_y]) obstructions++;
+bool GameState::can_attack(unsigned id, unsigned target_id) const {
+  const auto engine_answer = [&] { return gc.can_attack(id, target_id); };
+  if (!my_units.contains(id)) return engine_answer();
+  const auto distance = distance_squared(id, target_id);
+  if (distance == -1) return engine_answer();
+
+  const auto unit_type = my_units.get_type(id);
+  auto answer = unit_type != Healer && !is_structure(unit_type) &&
+                distance <= (int)constants::ATTACK_RANGE[unit_type];
+  if (unit_type == Ranger) {
+    answer = answer && distance > (int)constants::RANGER_CANNOT_ATTACK_RANGE;
   }
-  return obstructions;
+  return check_rule(answer, engine_answer);
 }
 
-bool GameState::is_safe_location(unsigned x, unsigned y, int radius) const {
-  // TODO: Improve based on enemy unit types and their attack ranges.
-  for (int i = -radius; i <= radius; i++) {
-    for (int j = -radius; j <= radius; j++) {
-      const auto probe_x = x + i;
-      const auto probe_y = y + j;
+bool GameState::is_attack_ready(unsigned id) const {
+  const auto &unit = get_unit(id);
+  const auto answer = unit.unit_type != Healer &&
+                      !is_structure(unit.unit_type) &&
+                      unit.attack_heat < constants::MAX_HEAT;
+  return check_rule(answer, [&] { return gc.is_attack_ready(id); });
+}
 
-      if (!map_info.is_valid_location(probe_x, probe_y)) continue;
-      if (enemy_units.is_occupied[probe_x][probe_y]) return false;
-    }
+bool GameState::can_heal(unsigned id, unsigned target_id) const {
+  const auto engine_answer = [&] { return gc.can_heal(id, target_id); };
+  if (!my_units.contains(id) || !my_units.contains(target_id)) {
+    return engine_answer();
   }
-  return true;
+
+  const auto answer =
+      my_units.get_type(id) == Healer &&
+      !is_structure(my_units.get_type(target_id)) &&
+      distance_squared(id, target_id) <= (int)constants::ATTACK_RANGE[Healer];
+  return check_rule(answer, engine_answer);
+}
+
+bool GameState::is_heal_ready(unsigned id) const {
+  const auto &unit = get_unit(id);
+  const auto answer =
+      unit.unit_type == Healer && unit.attack_heat < constants::MAX_HEAT;
+  return check_rule(answer, [&] { return gc.is_heal_ready(id); });
+}
+
+bool GameState::can_harvest(unsigned id, Direction dir) const {
+  const auto engine_answer = [&] { return gc.can_harvest(id, dir); };
+  if (!my_units.contains(id)) return engine_answer();
+
+  const auto loc = my_units.get_location(id).add(dir);
+  const auto x = loc.get_x();
+  const auto y = loc.get_y();
+  if (!is_known(x, y)) return engine_answer();
+  const auto answer = my_units.get_type(id) == Worker &&
+                      !get_unit(id).has_acted &&
+                      map_info.is_valid_location(x, y) &&
+                      map_info.get_karbonite(x, y) > 0;
+  return check_rule(answer, engine_answer);
+}
+
+bool GameState::can_replicate(unsigned id, Direction dir) const {
+  const auto engine_answer = [&] { return gc.can_replicate(id, dir); };
+  if (!my_units.contains(id)) return engine_answer();
+
+  const auto loc = my_units.get_location(id).add(dir);
+  if (!is_known(loc.get_x(), loc.get_y())) return engine_answer();
+  auto answer = my_units.get_type(id) == Worker &&
+                karbonite >= constants::REPLICATION_COST &&
+                is_free(loc.get_x(), loc.get_y());
+  if (answer) {
+    const auto &unit = get_unit(id);
+    answer = !unit.has_acted && unit.ability_heat < constants::MAX_HEAT;
+  }
+  return check_rule(answer, engine_answer);
+}
+
+bool GameState::can_blueprint(unsigned id, UnitType unit_type,
+                              Direction dir) const {
+  const auto engine_answer = [&] {
+    return gc.can_blueprint(id, unit_type, dir);
+  };
+  // Rockets need research, which isn't tracked.
+  if (!my_units.contains(id) || unit_type == Rocket) return engine_answer();
+
+  const auto loc = my_units.get_location(id).add(dir);
+  if (!is_known(loc.get_x(), loc.get_y())) return engine_answer();
+  const auto answer = PLANET == Earth && is_structure(unit_type) &&
+                      my_units.get_type(id) == Worker &&
+                      karbonite >= constants::BLUEPRINT_COST[unit_type] &&
+                      is_free(loc.get_x(), loc.get_y()) &&
+                      !get_unit(id).has_acted;
+  return check_rule(answer, engine_answer);
+}
+
+bool GameState::can_build(unsigned worker_id, unsigned structure_id) const {
+  const auto engine_answer = [&] {
+    return gc.can_build(worker_id, structure_id);
+  };
+  if (!my_units.contains(worker_id) || !my_units.contains(structure_id)) {
+    return engine_answer();
+  }
+
+  const auto answer = my_units.get_type(worker_id) == Worker &&
+                      is_structure(my_units.get_type(structure_id)) &&
+                      distance_squared(worker_id, structure_id) <= 2 &&
+                      !get_unit(worker_id).has_acted &&
+                      !get_unit(structure_id).is_built;
+  return check_rule(answer, engine_answer);
+}
+
+bool GameState::can_repair(unsigned worker_id, unsigned structure_id) const {
+  const auto engine_answer = [&] {
+    return gc.can_repair(worker_id, structure_id);
+  };
+  if (!my_units.contains(worker_id) || !my_units.contains(structure_id)) {
+    return engine_answer();
+  }
+
+  const auto answer = my_units.get_type(worker_id) == Worker &&
+                      is_structure(my_units.get_type(structure_id)) &&
+                      distance_squared(worker_id, structure_id) <= 2 &&
+                      !get_unit(worker_id).has_acted &&
+                      get_unit(structure_id).is_built;
+  return check_rule(answer, engine_answer);
 }
 
 void GameState::move(unsigned id, Direction dir) {
   my_units.move(id, dir);
   gc.move_robot(id, dir);
+  unit_cache.invalidate(id);
 }
 
 unsigned GameState::blueprint(unsigned id, UnitType unit_type, Direction dir) {
   gc.blueprint(id, unit_type, dir);
-  const auto loc = my_units.by_id[id].second.add(dir);
-  const auto structure_id = gc.sense_unit_at_location(loc).get_id();
+  unit_cache.invalidate(id);
+  const auto loc = my_units.get_location(id).add(dir);
+  const auto &ml = map_info.get_map_location(loc);
+  const auto structure_id = gc.sense_unit_at_location(ml).get_id();
   my_units.add(structure_id, unit_type, loc);
+  block_cell(loc.get_x(), loc.get_y());
   karbonite = gc.get_karbonite();
   return structure_id;
 }
@@ -97,20 +302,38 @@ unsigned GameState::blueprint(unsigned id, UnitType unit_type, Direction dir) {
 void GameState::load(unsigned structure_id, unsigned robot_id) {
   gc.load(structure_id, robot_id);
   my_units.remove(robot_id);
+  unit_cache.invalidate(structure_id);
+  unit_cache.invalidate(robot_id);
+}
+
+void GameState::build(unsigned worker_id, unsigned structure_id) {
+  gc.build(worker_id, structure_id);
+  unit_cache.invalidate(worker_id);
+  unit_cache.invalidate(structure_id);
+}
+
+void GameState::repair(unsigned worker_id, unsigned structure_id) {
+  gc.repair(worker_id, structure_id);
+  unit_cache.invalidate(worker_id);
+  unit_cache.invalidate(structure_id);
 }
 
 unsigned GameState::unload(unsigned structure_id, Direction dir) {
   gc.unload(structure_id, dir);
-  const auto loc = my_units.by_id[structure_id].second.add(dir);
-  const auto &robot = gc.sense_unit_at_location(loc);
+  unit_cache.invalidate(structure_id);
+  const auto loc = my_units.get_location(structure_id).add(dir);
+  const auto &robot = gc.sense_unit_at_location(map_info.get_map_location(loc));
   const auto robot_id = robot.get_id();
   my_units.add(robot_id, robot.get_unit_type(), loc);
   return robot_id;
 }
 
-void GameState::launch(unsigned rocket_id, const MapLocation &loc) {
-  gc.launch_rocket(rocket_id, loc);
+void GameState::launch(unsigned rocket_id, const Coord &loc) {
+  gc.launch_rocket(rocket_id, loc.to_map_location());
+  unit_cache.invalidate(rocket_id);
+  const auto rocket_loc = my_units.get_location(rocket_id);
   my_units.remove(rocket_id);
+  unblock_cell(rocket_loc.get_x(), rocket_loc.get_y());
 
   // Update units around the rocket if they were destroyed.
   const auto x = loc.get_x();
@@ -120,48 +343,65 @@ void GameState::launch(unsigned rocket_id, const MapLocation &loc) {
     const auto probe_y = y + constants::DY[i];
 
     if (!map_info.is_valid_location(probe_x, probe_y)) continue;
-    const auto probe_loc = map_info.get_location(probe_x, probe_y);
+    const auto &probe_loc = map_info.get_map_location(probe_x, probe_y);
 
     if (gc.can_sense_location(probe_loc) && gc.has_unit_at_location(probe_loc))
       continue;
 
-    if (my_units.is_occupied[probe_x][probe_y]) {
-      const auto unit_id = my_units.by_location[probe_x][probe_y];
+    if (my_units.is_occupied(probe_x, probe_y)) {
+      const auto unit_id = my_units.get_id_at(probe_x, probe_y);
       if (!gc.has_unit(unit_id)) my_units.remove(unit_id);
-    } else if (enemy_units.is_occupied[probe_x][probe_y]) {
-      const auto unit_id = enemy_units.by_location[probe_x][probe_y];
-      if (!gc.has_unit(unit_id)) enemy_units.remove(unit_id);
+      unit_cache.invalidate(unit_id);
+    } else if (enemy_units.is_occupied(probe_x, probe_y)) {
+      const auto unit_id = enemy_units.get_id_at(probe_x, probe_y);
+      if (!gc.has_unit(unit_id)) {
+        enemy_units.remove(unit_id);
+        enemy_memory.forget(unit_id);
+      }
+      unit_cache.invalidate(unit_id);
     }
   }
 }
 
 void GameState::disintegrate(unsigned id) {
   gc.disintegrate_unit(id);
+  unit_cache.invalidate(id);
+  const auto unit_type = my_units.get_type(id);
+  const auto x = my_units.get_x(id);
+  const auto y = my_units.get_y(id);
   my_units.remove(id);
+  if (unit_type == Factory || unit_type == Rocket) {
+    unblock_cell(x, y);
+  }
 }
 
 void GameState::attack(unsigned id, unsigned target_id) {
   gc.attack(id, target_id);
+  unit_cache.invalidate(id);
   update_if_dead(target_id);
 
-  const auto unit = my_units.by_id[id];
-  if (unit.first == Healer) {
-    const auto loc = unit.second;
-    const auto unit_x = loc.get_x();
-    const auto unit_y = loc.get_y();
+  if (my_units.get_type(id) == Healer) {
+    const auto unit_x = my_units.get_x(id);
+    const auto unit_y = my_units.get_y(id);
     for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
       const auto x = unit_x + constants::DX[i];
       const auto y = unit_y + constants::DY[i];
       if (!map_info.is_valid_location(x, y)) continue;
-      if (my_units.is_occupied[x][y]) {
-        update_if_dead(my_units.by_location[x][y]);
-      } else if (enemy_units.is_occupied[x][y]) {
-        update_if_dead(enemy_units.by_location[x][y]);
+      if (my_units.is_occupied(x, y)) {
+        update_if_dead(my_units.get_id_at(x, y));
+      } else if (enemy_units.is_occupied(x, y)) {
+        update_if_dead(enemy_units.get_id_at(x, y));
       }
     }
   }
 }
 
+void GameState::heal(unsigned id, unsigned target_id) {
+  gc.heal(id, target_id);
+  unit_cache.invalidate(id);
+  update_if_dead(target_id);
+}
+
 bool GameState::special_attack(unsigned id, UnitType unit_type,
                                unsigned target_id) {
   switch (unit_type) {
@@ -170,6 +410,7 @@ bool GameState::special_attack(unsigned id, UnitType unit_type,
     case Knight:
       if (gc.can_javelin(id, target_id) && gc.is_javelin_ready(id)) {
         gc.javelin(id, target_id);
+        unit_cache.invalidate(id);
         update_if_dead(target_id);
         return true;
       }
@@ -181,6 +422,8 @@ bool GameState::special_attack(unsigned id, UnitType unit_type,
     case Healer:
       if (gc.can_overcharge(id, target_id) && gc.is_overcharge_ready(id)) {
         gc.overcharge(id, target_id);
+        unit_cache.invalidate(id);
+        unit_cache.invalidate(target_id);
         return true;
       }
       break;
@@ -192,17 +435,21 @@ bool GameState::special_attack(unsigned id, UnitType unit_type,
 
 void GameState::harvest(unsigned id, Direction dir) {
   gc.harvest(id, dir);
-  const auto loc = my_units.by_id[id].second.add(dir);
+  unit_cache.invalidate(id);
+  const auto loc = my_units.get_location(id).add(dir);
   const auto x = loc.get_x();
   const auto y = loc.get_y();
-  map_info.karbonite[x][y] = gc.get_karbonite_at(loc);
+  const auto &ml = map_info.get_map_location(x, y);
+  map_info.karbonite.set(x, y, gc.get_karbonite_at(ml), round);
   karbonite = gc.get_karbonite();
 }
 
 unsigned GameState::replicate(unsigned id, Direction dir) {
   gc.replicate(id, dir);
-  const auto loc = my_units.by_id[id].second.add(dir);
-  const auto replicated_id = gc.sense_unit_at_location(loc).get_id();
+  unit_cache.invalidate(id);
+  const auto loc = my_units.get_location(id).add(dir);
+  const auto &ml = map_info.get_map_location(loc);
+  const auto replicated_id = gc.sense_unit_at_location(ml).get_id();
   my_units.add(replicated_id, Worker, loc);
   karbonite = gc.get_karbonite();
   return replicated_id;
@@ -210,5 +457,6 @@ unsigned GameState::replicate(unsigned id, Direction dir) {
 
 void GameState::produce(unsigned factory_id, UnitType unit_type) {
   gc.produce_robot(factory_id, unit_type);
+  unit_cache.invalidate(factory_id);
   karbonite = gc.get_karbonite();
 }
@@ -0,0 +1,75 @@
+#include "KarboniteIndex.hpp"
+#include "constants.hpp"
+
+using namespace std;
+
+constexpr float KarboniteIndex::DECAY;
+constexpr int KarboniteIndex::REGION_SIZE;
+
+KarboniteIndex::KarboniteIndex(int width, int height)
+    : width(width),
+      height(height),
+      region_width((width + REGION_SIZE - 1) / REGION_SIZE),
+      region_height((height + REGION_SIZE - 1) / REGION_SIZE),
+      amount(width * height),
+      seen_round(width * height),
+      deposit_index(width * height, -1),
+      stale_index(width * height, -1),
+      region_karbonite(region_width * region_height),
+      decay(constants::N_ROUNDS + 1) {
+  decay[0] = 1;
+  for (int age = 1; age <= constants::N_ROUNDS; age++) {
+    decay[age] = decay[age - 1] * DECAY;
+  }
+}
+
+void KarboniteIndex::set(int x, int y, float new_amount, uint32_t round) {
+  const auto cell = x * height + y;
+  region_karbonite[x / REGION_SIZE * region_height + y / REGION_SIZE] +=
+      new_amount - amount[cell];
+  amount[cell] = new_amount;
+  seen_round[cell] = round;
+
+  if (stale_index[cell] != -1) remove(stale, stale_index, cell);
+  if (new_amount >= 1 && deposit_index[cell] == -1) {
+    add(deposits, deposit_index, x, y);
+  } else if (new_amount < 1 && deposit_index[cell] != -1) {
+    remove(deposits, deposit_index, cell);
+  }
+}
+
+float KarboniteIndex::get(int x, int y, uint32_t round) const {
+  const auto cell = x * height + y;
+  if (deposit_index[cell] == -1) return 0;
+
+  const auto age = min<uint32_t>(round - seen_round[cell], constants::N_ROUNDS);
+  const auto expected = amount[cell] * decay[age];
+  return expected < 1 ? 0 : expected;
+}
+
+void KarboniteIndex::prune(uint32_t round) {
+  // Backwards, as removing a deposit moves the last one into its place.
+  for (int i = (int)deposits.size() - 1; i >= 0; i--) {
+    const auto x = deposits[i].first;
+    const auto y = deposits[i].second;
+    if (get(x, y, round) != 0) continue;
+    remove(deposits, deposit_index, x * height + y);
+    add(stale, stale_index, x, y);
+  }
+}
+
+void KarboniteIndex::add(vector<pii> &cells, vector<int> &index, int x,
+                         int y) {
+  index[x * height + y] = cells.size();
+  cells.push_back(make_pair(x, y));
+}
+
+void KarboniteIndex::remove(vector<pii> &cells, vector<int> &index,
+                            int cell) {
+  const auto i = index[cell];
+  const auto &last = cells.back();
+  index[last.first * height + last.second] = i;
+  cells[i] = last;
+  cells.pop_back();
+  index[cell] = -1;
+}
@@ -0,0 +1,128 @@
+#include "LandingSiteIndex.hpp"
+#include <algorithm>
+#include "constants.hpp"
+
+using namespace bc;
+using namespace std;
+
+constexpr int LandingSiteIndex::CLAIM_RADIUS;
+constexpr int LandingSiteIndex::KARBONITE_RADIUS;
+
+LandingSiteIndex::LandingSiteIndex(const MapInfo &map_info)
+    : width(map_info.width),
+      height(map_info.height),
+      planet(map_info.planet),
+      component(width, vector<int>(height, -1)),
+      karbonite_sums(width + 1, vector<double>(height + 1)),
+      openness(width, vector<int>(height)),
+      is_claimed(width, vector<bool>(height)),
+      next_site(0) {
+  find_components(map_info);
+
+  for (int i = 0; i < width; i++) {
+    for (int j = 0; j < height; j++) {
+      karbonite_sums[i + 1][j + 1] = map_info.get_karbonite(i, j) +
+                                     karbonite_sums[i][j + 1] +
+                                     karbonite_sums[i + 1][j] -
+                                     karbonite_sums[i][j];
+
+      for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+        const auto x = i + constants::DX[k];
+        const auto y = j + constants::DY[k];
+        if (map_info.is_valid_location(x, y) &&
+            map_info.passable_terrain[x][y]) {
+          openness[i][j]++;
+        }
+      }
+    }
+  }
+
+  // Open sites land safely and let the garrison unload, karbonite feeds the
+  // workers and a large component leaves room to move on.
+  vector<pair<double, pii>> scored_sites;
+  for (int i = 0; i < width; i++) {
+    for (int j = 0; j < height; j++) {
+      if (component[i][j] == -1) continue;
+      const auto score = 4. * openness[i][j] +
+                         karbonite_around(i, j, KARBONITE_RADIUS) / 20 +
+                         min(component_size[component[i][j]], 100) / 10.;
+      scored_sites.push_back(make_pair(-score, pii(i, j)));
+    }
+  }
+  sort(scored_sites.begin(), scored_sites.end());
+
+  for (const auto &site : scored_sites) {
+    ranked_sites.push_back(site.second);
+  }
+}
+
+void LandingSiteIndex::find_components(const MapInfo &map_info) {
+  vector<pii> stack;
+  for (int i = 0; i < width; i++) {
+    for (int j = 0; j < height; j++) {
+      if (!map_info.passable_terrain[i][j] || component[i][j] != -1) continue;
+
+      const int id = component_size.size();
+      component_size.push_back(0);
+      component[i][j] = id;
+      stack.push_back(pii(i, j));
+      while (!stack.empty()) {
+        const auto cell = stack.back();
+        stack.pop_back();
+        component_size[id]++;
+
+        for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+          const auto x = cell.first + constants::DX[k];
+          const auto y = cell.second + constants::DY[k];
+          if (!map_info.is_valid_location(x, y)) continue;
+          if (!map_info.passable_terrain[x][y] || component[x][y] != -1) {
+            continue;
+          }
+          component[x][y] = id;
+          stack.push_back(pii(x, y));
+        }
+      }
+    }
+  }
+}
+
+bool LandingSiteIndex::get_best_site(Coord &site) {
+  if (ranked_sites.empty()) return false;
+
+  while (next_site < ranked_sites.size()) {
+    const auto &cell = ranked_sites[next_site];
+    if (!is_claimed[cell.first][cell.second]) {
+      site = Coord(planet, cell.first, cell.second);
+      return true;
+    }
+    next_site++;
+  }
+
+  // Every site is taken, start over from the best ones.
+  for (auto &column : is_claimed) {
+    fill(column.begin(), column.end(), false);
+  }
+  next_site = 0;
+  const auto &cell = ranked_sites[0];
+  site = Coord(planet, cell.first, cell.second);
+  return true;
+}
+
+void LandingSiteIndex::claim(int x, int y) {
+  for (int i = max(0, x - CLAIM_RADIUS); i <= min(width - 1, x + CLAIM_RADIUS);
+       i++) {
+    for (int j = max(0, y - CLAIM_RADIUS);
+         j <= min(height - 1, y + CLAIM_RADIUS); j++) {
+      is_claimed[i][j] = true;
+    }
+  }
+}
+
+double LandingSiteIndex::karbonite_around(int x, int y, int radius) const {
+  const auto x_lo = max(0, x - radius);
+  const auto x_hi = min(width, x + radius + 1);
+  const auto y_lo = max(0, y - radius);
+  const auto y_hi = min(height, y + radius + 1);
+  return karbonite_sums[x_hi][y_hi] - karbonite_sums[x_lo][y_hi] -
+         karbonite_sums[x_hi][y_lo] + karbonite_sums[x_lo][y_lo];
+}
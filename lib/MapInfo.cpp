@@ -1,4 +1,5 @@
 #include "MapInfo.hpp"
+#include <cmath>
 
 using namespace std;
 using namespace bc;
@@ -7,19 +8,59 @@ MapInfo::MapInfo(const PlanetMap &map)
     : width((int)map.get_width()),
       height((int)map.get_height()),
       planet(map.get_planet()),
-      karbonite(width, vector<float>(height)),
+      round(1),
+      karbonite(width, height),
       passable_terrain(width, vector<bool>(height)),
-      can_sense(width, vector<bool>(height)) {
+      passable(width, height),
+      impassable(width, height),
+      can_sense(width, height),
+      asteroid_round(1) {
+  for (int unit_type = 0; unit_type < constants::N_UNIT_TYPES; unit_type++) {
+    const int range = constants::VISION_RANGE[unit_type];
+    const int radius = sqrt(range);
+    for (int dx = -radius; dx <= radius; dx++) {
+      vision_columns[unit_type].push_back(
+          make_pair(dx, (int)sqrt(range - dx * dx)));
+    }
+  }
+
+  map_locations.reserve(width * height);
   for (int i = 0; i < width; i++) {
     for (int j = 0; j < height; j++) {
-      const auto ml = get_location(i, j);
-      karbonite[i][j] = map.get_initial_karbonite_at(ml);
+      map_locations.push_back(MapLocation(planet, i, j));
+      const auto &ml = get_map_location(i, j);
+      karbonite.set(i, j, map.get_initial_karbonite_at(ml), round);
       passable_terrain[i][j] = map.is_passable_terrain_at(ml);
+      passable.assign(i, j, passable_terrain[i][j]);
+      impassable.assign(i, j, !passable_terrain[i][j]);
+    }
+  }
+
+  symmetry = NO_SYMMETRY;
+  for (const auto candidate :
+       {HORIZONTAL_SYMMETRY, VERTICAL_SYMMETRY, ROTATIONAL_SYMMETRY}) {
+    if (is_symmetric(candidate)) {
+      symmetry = candidate;
+      break;
+    }
+  }
+}
+
+bool MapInfo::is_symmetric(Symmetry candidate) const {
+  for (int i = 0; i < width; i++) {
+    for (int j = 0; j < height; j++) {
+      const auto mirror_i = flips_x(candidate) ? width - 1 - i : i;
+      const auto mirror_j = flips_y(candidate) ? height - 1 - j : j;
+      if (passable_terrain[i][j] != passable_terrain[mirror_i][mirror_j] ||
+          get_karbonite(i, j) != get_karbonite(mirror_i, mirror_j)) {
+        return false;
+      }
     }
   }
+  return true;
 }
 
-MapLocation MapInfo::get_random_passable_location() const {
+Coord MapInfo::get_random_passable_location() const {
   while (true) {
     int x = rand() % width;
     int y = rand() % height;
@@ -29,20 +70,45 @@ MapLocation MapInfo::get_random_passable_location() const {
   }
 }
 
-void MapInfo::update(const GameController &gc) {
-  for (int i = 0; i < width; i++) {
-    for (int j = 0; j < height; j++) {
-      const auto ml = get_location(i, j);
-      const auto is_sensible = gc.can_sense_location(ml);
-      can_sense[i][j] = is_sensible;
-
-      if (is_sensible) {
-        karbonite[i][j] = gc.get_karbonite_at(ml);
-      } else {
-        // Depreciate unseen karbonite.
-        karbonite[i][j] *= 0.99;
-        if (karbonite[i][j] < 1) karbonite[i][j] = 0;
+void MapInfo::update(const GameController &gc, const UnitList &my_units) {
+  round = gc.get_round();
+
+  // Units in garrisons and in space aren't in the list, and see nothing.
+  can_sense.clear();
+  for (int slot = 0; slot < (int)my_units.size(); slot++) {
+    const int x = my_units.xs[slot];
+    const int y = my_units.ys[slot];
+    for (const auto &column : vision_columns[my_units.types[slot]]) {
+      can_sense.set_span(x + column.first, y, column.second);
+    }
+  }
+
+  // Karbonite only ever appears from asteroids, so the cells without any
+  // need no look.
+  if (planet == Mars) {
+    const auto &pattern = gc.get_asteroid_pattern();
+    for (; asteroid_round < round; asteroid_round++) {
+      if (!pattern.has_asteroid_on_round(asteroid_round)) continue;
+      const auto strike = pattern.get_asteroid_on_round(asteroid_round);
+      const auto loc = strike.get_map_location();
+      const auto x = loc.get_x();
+      const auto y = loc.get_y();
+      karbonite.set(x, y, get_karbonite(x, y) + strike.get_karbonite(), round);
+    }
+  }
+
+  // Stale cells in sight are looked at again too, since the depreciation
+  // that emptied them was only a guess. Backwards, as cells leaving either
+  // list are swapped with its last one.
+  for (const auto cells : {&karbonite.deposits, &karbonite.stale}) {
+    for (int i = (int)cells->size() - 1; i >= 0; i--) {
+      const auto x = (*cells)[i].first;
+      const auto y = (*cells)[i].second;
+      if (can_sense.test(x, y)) {
+        karbonite.set(x, y, gc.get_karbonite_at(get_map_location(x, y)),
+                      round);
       }
     }
   }
+  karbonite.prune(round);
 }
@@ -0,0 +1,51 @@
+#include "NearestTargetField.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace bc;
+using namespace std;
+
+NearestTargetField::NearestTargetField(
+    const PairwiseDistances &pd,
+    const vector<pair<Coord, float>> &targets)
+    : height(pd.height),
+      target(pd.field_size, -1),
+      cost(pd.field_size, numeric_limits<float>::infinity()) {
+  // Within a weight the nearest target is the best one, so a BFS from all of
+  // them at once settles it.
+  vector<int> by_weight(targets.size());
+  for (int i = 0; i < (int)targets.size(); i++) {
+    by_weight[i] = i;
+  }
+  stable_sort(by_weight.begin(), by_weight.end(), [&](int a, int b) {
+    return targets[a].second < targets[b].second;
+  });
+
+  vector<PairwiseDistances::pii> goals;
+  vector<int> goal_targets;
+  vector<unsigned short> distance;
+  vector<int> nearest;
+  for (size_t begin = 0; begin < by_weight.size();) {
+    const auto weight = targets[by_weight[begin]].second;
+    goals.clear();
+    goal_targets.clear();
+    size_t end = begin;
+    for (; end < by_weight.size() && targets[by_weight[end]].second == weight;
+         end++) {
+      const auto &loc = targets[by_weight[end]].first;
+      goals.push_back(make_pair(loc.get_x(), loc.get_y()));
+      goal_targets.push_back(by_weight[end]);
+    }
+    begin = end;
+
+    pd.compute_nearest(goals, distance, nearest);
+    for (int cell = 0; cell < pd.field_size; cell++) {
+      if (nearest[cell] == -1) continue;
+      const auto cell_cost = weight * distance[cell];
+      if (cell_cost < cost[cell]) {
+        cost[cell] = cell_cost;
+        target[cell] = goal_targets[nearest[cell]];
+      }
+    }
+  }
+}
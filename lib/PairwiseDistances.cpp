@@ -1,96 +1,605 @@
 #include "PairwiseDistances.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <limits>
 #include <memory>
 #include <queue>
+#include <thread>
 
 using namespace bc;
 using namespace std;
 
+constexpr unsigned short PairwiseDistances::UNREACHABLE;
+constexpr uint8_t PairwiseDistances::COMPACT_FAR;
+constexpr uint8_t PairwiseDistances::COMPACT_UNREACHABLE;
+
+namespace {
+
+// Layout of a table file: this header followed by every field.
+struct TableFileHeader {
+  uint64_t magic;
+  uint64_t hash;
+  uint32_t width;
+  uint32_t height;
+  uint32_t entry_size;
+  uint32_t padding;
+};
+
+constexpr uint64_t TABLE_FILE_MAGIC = 0x3174736944636231;  // "1bcDist1"
+
+// Whether `st` is ours and nobody else can write to it, so that what it holds
+// was written by one of our own games.
+bool is_private(const struct stat &st) {
+  return st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+// Creates `dir` if needed, and checks that it is a private directory.
+bool make_private_dir(const string &dir) {
+  mkdir(dir.c_str(), 0700);
+  struct stat st;
+  return lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) &&
+         is_private(st);
+}
+
+}  // namespace
+
 PairwiseDistances::PairwiseDistances(
     const vector<vector<bool>> &passable_terrain,
-    const vector<PairwiseDistances::pii> &kernel) {
-  distances = (HugeArray *)malloc(sizeof(HugeArray));
-  assert(distances != nullptr);
+    const vector<PairwiseDistances::pii> &kernel,
+    const PairwiseDistances::Config &config)
+    : compact(config.compact),
+      lazy(config.cache_budget > 0),
+      wide_fields(nullptr),
+      compact_fields(nullptr),
+      mapping(nullptr),
+      mapping_size(0),
+      lru_head(-1),
+      lru_tail(-1),
+      n_used_slots(0),
+      cache_hits(0),
+      cache_misses(0),
+      n_overlays(0),
+      movement(nullptr),
+      n_blocked(0),
+      kernel(kernel) {
   int n = (int)passable_terrain.size();
   int m = (int)passable_terrain[0].size();
   width = n;
   height = m;
+  field_size = n * m;
   assert(n <= constants::MAX_MAP_SIZE);
   assert(m <= constants::MAX_MAP_SIZE);
 
-  bool pass[constants::MAX_MAP_SIZE][constants::MAX_MAP_SIZE];
+  memset(terrain, 0, sizeof(terrain));
   for (int i = 0; i < n; i++) {
     for (int j = 0; j < m; j++) {
-      pass[i][j] = passable_terrain[i][j];
+      if (passable_terrain[i][j]) terrain[i] |= 1ull << j;
     }
   }
+  memcpy(pass, terrain, sizeof(pass));
+  build_kernel_spans();
 
-  bool visited[constants::MAX_MAP_SIZE][constants::MAX_MAP_SIZE];
+  symmetry = NO_SYMMETRY;
+  if (has_symmetry(config.symmetry)) symmetry = config.symmetry;
 
-  memset(distances, -1, sizeof(*distances));
+  if (lazy) {
+    const size_t field_bytes =
+        field_size * (compact ? sizeof(uint8_t) : sizeof(unsigned short));
+    n_slots = (int)max<size_t>(1, config.cache_budget / field_bytes);
+    n_slots = min(n_slots, field_size);
 
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < m; j++) {
-      if (!pass[i][j]) continue;
+    slot_of_goal.assign(field_size, -1);
+    goal_of_slot.assign(n_slots, -1);
+    lru_prev.assign(n_slots, -1);
+    lru_next.assign(n_slots, -1);
+  } else if (symmetry != NO_SYMMETRY) {
+    slot_of_goal.assign(field_size, -1);
+    for (int i = 0; i < width; i++) {
+      for (int j = 0; j < height; j++) {
+        if (!is_canonical(i, j)) continue;
+        slot_of_goal[i * height + j] = goal_of_slot.size();
+        goal_of_slot.push_back(i * height + j);
+      }
+    }
+    n_slots = goal_of_slot.size();
+  } else {
+    n_slots = field_size;
+  }
 
-      memset(visited, 0, sizeof(visited));
+  if (lazy) {
+    allocate_fields();
+    return;
+  }
+  overlay_of_goal.assign(field_size, -1);
 
-      std::queue<pii> q;
+  string path;
+  if (!config.cache_dir.empty() && make_private_dir(config.cache_dir)) {
+    char name[64];
+    snprintf(name, sizeof(name), "/distances-%016llx.bin",
+             (unsigned long long)table_hash());
+    path = config.cache_dir + name;
+    if (map_table_file(path)) return;
+  }
 
-      for (int k = 0; k < (int)kernel.size(); k++) {
-        int x = i + kernel[k].first;
-        int y = j + kernel[k].second;
+  allocate_fields();
+  compute_all_slots(resolve_thread_count(config.n_threads));
 
-        if (x >= 0 && x < n && y >= 0 && y < m && !visited[x][y] &&
-            pass[x][y]) {
-          q.push(pii(x, y));
-          visited[x][y] = true;
-        }
+  if (!path.empty()) write_table_file(path);
+}
+
+void PairwiseDistances::allocate_fields() {
+  owned_fields.resize(fields_bytes());
+  if (compact) {
+    compact_fields = owned_fields.data();
+  } else {
+    wide_fields = reinterpret_cast<unsigned short *>(owned_fields.data());
+  }
+}
+
+size_t PairwiseDistances::fields_bytes() const {
+  const size_t entry_size = compact ? sizeof(uint8_t) : sizeof(unsigned short);
+  return (size_t)n_slots * field_size * entry_size;
+}
+
+uint64_t PairwiseDistances::table_hash() const {
+  // FNV-1a over everything the fields depend on.
+  uint64_t hash = 0xcbf29ce484222325;
+  const auto mix = [&hash](uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+      hash ^= (value >> (8 * i)) & 0xff;
+      hash *= 0x100000001b3;
+    }
+  };
+
+  mix(width);
+  mix(height);
+  mix(compact);
+  mix(symmetry);
+  for (int x = 0; x < width; x++) {
+    mix(terrain[x]);
+  }
+  mix(kernel.size());
+  for (const auto &offset : kernel) {
+    mix((uint32_t)offset.first);
+    mix((uint32_t)offset.second);
+  }
+  return hash;
+}
+
+bool PairwiseDistances::map_table_file(const string &path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW);
+  if (fd == -1) return false;
+
+  const size_t size = sizeof(TableFileHeader) + fields_bytes();
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && is_private(st) &&
+      (size_t)st.st_size == size) {
+    data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) return false;
+
+  const auto header = static_cast<const TableFileHeader *>(data);
+  if (header->magic != TABLE_FILE_MAGIC || header->hash != table_hash() ||
+      header->width != (uint32_t)width || header->height != (uint32_t)height ||
+      header->entry_size != (compact ? 1 : 2)) {
+    munmap(data, size);
+    return false;
+  }
+
+  mapping = data;
+  mapping_size = size;
+  const auto fields = static_cast<uint8_t *>(data) + sizeof(TableFileHeader);
+  if (compact) {
+    compact_fields = fields;
+  } else {
+    wide_fields = reinterpret_cast<unsigned short *>(fields);
+  }
+  return true;
+}
+
+void PairwiseDistances::write_table_file(const string &path) const {
+  // Write to a private file first, so that readers only ever see complete
+  // tables. Only we may write it, whatever the umask.
+  const auto tmp_path = path + "." + to_string(getpid()) + ".tmp";
+  const int fd =
+      open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+  if (fd == -1) return;
+  FILE *file = fdopen(fd, "wb");
+  if (file == nullptr) {
+    close(fd);
+    remove(tmp_path.c_str());
+    return;
+  }
+
+  TableFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = TABLE_FILE_MAGIC;
+  header.hash = table_hash();
+  header.width = width;
+  header.height = height;
+  header.entry_size = compact ? 1 : 2;
+
+  auto ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(owned_fields.data(), 1, owned_fields.size(), file) ==
+                owned_fields.size();
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    remove(tmp_path.c_str());
+  }
+}
+
+PairwiseDistances::PairwiseDistances(
+    const PairwiseDistances &movement,
+    const vector<PairwiseDistances::pii> &kernel)
+    : width(movement.width),
+      height(movement.height),
+      field_size(movement.field_size),
+      compact(movement.compact),
+      lazy(false),
+      symmetry(NO_SYMMETRY),
+      n_slots(0),
+      wide_fields(nullptr),
+      compact_fields(nullptr),
+      mapping(nullptr),
+      mapping_size(0),
+      lru_head(-1),
+      lru_tail(-1),
+      n_used_slots(0),
+      cache_hits(0),
+      cache_misses(0),
+      n_overlays(0),
+      movement(&movement),
+      n_blocked(0),
+      kernel(kernel) {
+  assert(movement.movement == nullptr);
+  assert(movement.kernel == constants::POINT_KERNEL);
+  memcpy(terrain, movement.terrain, sizeof(terrain));
+  memcpy(pass, terrain, sizeof(pass));
+  build_kernel_spans();
+
+  // Mirroring a query mirrors the kernel around the goal too.
+  assert(has_symmetry(movement.symmetry));
+}
+
+void PairwiseDistances::build_kernel_spans() {
+  auto offsets = kernel;
+  sort(offsets.begin(), offsets.end());
+  offsets.erase(unique(offsets.begin(), offsets.end()), offsets.end());
+  for (const auto &offset : offsets) {
+    if (!kernel_spans.empty() && kernel_spans.back().dx == offset.first &&
+        kernel_spans.back().dy_hi + 1 == offset.second) {
+      kernel_spans.back().dy_hi++;
+    } else {
+      kernel_spans.push_back({offset.first, offset.second, offset.second});
+    }
+  }
+}
+
+bool PairwiseDistances::in_kernel(int dx, int dy) const {
+  for (const auto &span : kernel_spans) {
+    if (span.dx == dx && span.dy_lo <= dy && dy <= span.dy_hi) return true;
+  }
+  return false;
+}
+
+bool PairwiseDistances::has_symmetry(Symmetry candidate) const {
+  if (candidate == NO_SYMMETRY) return true;
+
+  for (const auto &offset : kernel) {
+    const int dx = flips_x(candidate) ? -offset.first : offset.first;
+    const int dy = flips_y(candidate) ? -offset.second : offset.second;
+    if (!in_kernel(dx, dy)) return false;
+  }
+
+  for (int x = 0; x < width; x++) {
+    for (int y = 0; y < height; y++) {
+      const int mirror_x = flips_x(candidate) ? width - 1 - x : x;
+      const int mirror_y = flips_y(candidate) ? height - 1 - y : y;
+      if ((terrain[x] >> y & 1) != (terrain[mirror_x] >> mirror_y & 1)) {
+        return false;
       }
+    }
+  }
+  return true;
+}
 
-      unsigned short dist = 0;
+void PairwiseDistances::mirror(int &x, int &y) const {
+  if (flips_x(symmetry)) x = width - 1 - x;
+  if (flips_y(symmetry)) y = height - 1 - y;
+}
 
-      while (!q.empty()) {
-        size_t size = q.size();
+bool PairwiseDistances::is_canonical(int goal_x, int goal_y) const {
+  int mirror_x = goal_x;
+  int mirror_y = goal_y;
+  mirror(mirror_x, mirror_y);
+  return goal_x * height + goal_y <= mirror_x * height + mirror_y;
+}
 
-        for (size_t qi = 0; qi < size; qi++) {
-          pii current = q.front();
-          q.pop();
+void PairwiseDistances::compute_all_slots(unsigned n_threads) {
+  // Every goal writes its own slot, so threads only need to agree on who
+  // takes which goal column.
+  atomic<int> next_x(0);
+  const auto worker = [this, &next_x]() {
+    unique_ptr<Scratch> scratch(new Scratch());
+    for (int i = next_x++; i < width; i = next_x++) {
+      for (int j = 0; j < height; j++) {
+        const int slot = get_slot(i, j);
+        if (slot != -1) compute_slot(slot, i, j, *scratch);
+      }
+    }
+  };
 
-          int ii = current.first;
-          int jj = current.second;
+  vector<thread> threads;
+  for (unsigned t = 1; t < n_threads; t++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+}
 
-          (*distances)[i][j][ii][jj] = dist;
+template <typename T>
+void PairwiseDistances::compute_field(int goal_x, int goal_y, T *field,
+                                      Scratch &scratch) const {
+  // The largest distance that can be stored, the next value means unreachable.
+  const unsigned short max_distance = numeric_limits<T>::max() - 1;
 
-          for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
-            int x = ii + constants::DX[k];
-            int y = jj + constants::DY[k];
+  const int n = width;
+  const int m = height;
 
-            if (x >= 0 && x < n && y >= 0 && y < m && !visited[x][y] &&
-                pass[x][y]) {
-              q.push(pii(x, y));
-              visited[x][y] = true;
-            }
-          }
-        }
+  fill(field, field + field_size, numeric_limits<T>::max());
+
+  if (!(terrain[goal_x] >> goal_y & 1)) return;
+
+  auto &visited = scratch.visited;
+  auto &frontier = scratch.frontier;
+  auto &next_frontier = scratch.next_frontier;
+  memset(frontier, 0, sizeof(frontier));
+
+  // Rows [lo, hi] may have frontier cells.
+  int lo = n;
+  int hi = -1;
+
+  for (int k = 0; k < (int)kernel.size(); k++) {
+    int x = goal_x + kernel[k].first;
+    int y = goal_y + kernel[k].second;
+
+    if (x >= 0 && x < n && y >= 0 && y < m) {
+      frontier[x] |= pass[x] & (1ull << y);
+      lo = min(lo, x);
+      hi = max(hi, x);
+    }
+  }
+  memcpy(visited, frontier, sizeof(visited));
 
-        dist++;
+  unsigned short dist = 0;
+
+  while (lo <= hi) {
+    const T stored_dist = (T)min(dist, max_distance);
+
+    for (int x = lo; x <= hi; x++) {
+      for (auto bits = frontier[x]; bits; bits &= bits - 1) {
+        field[x * m + __builtin_ctzll(bits)] = stored_dist;
+      }
+    }
+
+    // Cells of row x are reached from rows x - 1, x and x + 1.
+    int next_lo = n;
+    int next_hi = -1;
+    for (int x = max(0, lo - 1); x <= min(n - 1, hi + 1); x++) {
+      auto reached = frontier[x];
+      if (x > 0) reached |= frontier[x - 1];
+      if (x < n - 1) reached |= frontier[x + 1];
+      reached |= (reached << 1) | (reached >> 1);
+
+      next_frontier[x] = reached & pass[x] & ~visited[x];
+      if (next_frontier[x]) {
+        visited[x] |= next_frontier[x];
+        next_lo = min(next_lo, x);
+        next_hi = max(next_hi, x);
       }
     }
+
+    // Only rows [lo - 1, hi + 1] of the next frontier were written.
+    for (int x = max(0, lo - 1); x <= min(n - 1, hi + 1); x++) {
+      frontier[x] = next_frontier[x];
+    }
+    lo = next_lo;
+    hi = next_hi;
+    dist++;
   }
 }
 
+void PairwiseDistances::compute_slot(int slot, int goal_x, int goal_y,
+                                     Scratch &scratch) const {
+  const size_t offset = (size_t)slot * field_size;
+  if (compact) {
+    compute_field(goal_x, goal_y, &compact_fields[offset], scratch);
+  } else {
+    compute_field(goal_x, goal_y, &wide_fields[offset], scratch);
+  }
+}
+
+int PairwiseDistances::get_slot(int goal_x, int goal_y) const {
+  const int goal = goal_x * height + goal_y;
+  if (!lazy) return slot_of_goal.empty() ? goal : slot_of_goal[goal];
+
+  int slot = slot_of_goal[goal];
+  if (slot != -1) {
+    cache_hits++;
+    if (slot != lru_head) {
+      lru_unlink(slot);
+      lru_push_front(slot);
+    }
+    return slot;
+  }
+
+  cache_misses++;
+  if (n_used_slots < n_slots) {
+    slot = n_used_slots++;
+  } else {
+    // Evict the least recently used field.
+    slot = lru_tail;
+    lru_unlink(slot);
+    slot_of_goal[goal_of_slot[slot]] = -1;
+  }
+
+  slot_of_goal[goal] = slot;
+  goal_of_slot[slot] = goal;
+  lru_push_front(slot);
+
+  compute_slot(slot, goal_x, goal_y, serial_scratch);
+  return slot;
+}
+
+void PairwiseDistances::lru_unlink(int slot) const {
+  const auto prev = lru_prev[slot];
+  const auto next = lru_next[slot];
+  if (prev != -1) {
+    lru_next[prev] = next;
+  } else {
+    lru_head = next;
+  }
+  if (next != -1) {
+    lru_prev[next] = prev;
+  } else {
+    lru_tail = prev;
+  }
+  lru_prev[slot] = lru_next[slot] = -1;
+}
+
+void PairwiseDistances::lru_push_front(int slot) const {
+  lru_prev[slot] = -1;
+  lru_next[slot] = lru_head;
+  if (lru_head != -1) lru_prev[lru_head] = slot;
+  lru_head = slot;
+  if (lru_tail == -1) lru_tail = slot;
+}
+
 unsigned short PairwiseDistances::get_distance(int start_x, int start_y,
                                                int goal_x, int goal_y) const {
   if ((start_x < 0 || start_x >= width || start_y < 0 || start_y >= height) ||
       (goal_x < 0 || goal_x >= width || goal_y < 0 || goal_y >= height)) {
-    return std::numeric_limits<unsigned short>::max();
+    return UNREACHABLE;
+  }
+
+  if (movement != nullptr) {
+    if (movement->is_blocked(start_x, start_y)) return UNREACHABLE;
+
+    // Movement distances are symmetric, so the field of the start is the
+    // distance from every cell to the start.
+    const int start = start_x * height + start_y;
+    if (compact) {
+      const auto overlay = movement->get_overlay<uint8_t>(start);
+      if (overlay != nullptr) {
+        return get_derived_distance(overlay, goal_x, goal_y, false);
+      }
+    } else {
+      const auto overlay = movement->get_overlay<unsigned short>(start);
+      if (overlay != nullptr) {
+        return get_derived_distance(overlay, goal_x, goal_y, false);
+      }
+    }
+
+    const auto is_mirrored = movement->symmetry != NO_SYMMETRY &&
+                             !movement->is_canonical(start_x, start_y);
+    if (is_mirrored) {
+      movement->mirror(start_x, start_y);
+      movement->mirror(goal_x, goal_y);
+    }
+
+    const size_t offset =
+        (size_t)movement->get_slot(start_x, start_y) * field_size;
+    if (compact) {
+      return get_derived_distance(&movement->compact_fields[offset], goal_x,
+                                  goal_y, is_mirrored);
+    }
+    return get_derived_distance(&movement->wide_fields[offset], goal_x,
+                                goal_y, is_mirrored);
   }
-  return (*distances)[goal_x][goal_y][start_x][start_y];
+
+  if (is_blocked(start_x, start_y)) return UNREACHABLE;
+
+  const int goal = goal_x * height + goal_y;
+  const int start = start_x * height + start_y;
+  if (compact) {
+    const auto overlay = get_overlay<uint8_t>(goal);
+    if (overlay != nullptr) {
+      return overlay[start] == COMPACT_UNREACHABLE ? UNREACHABLE
+                                                   : overlay[start];
+    }
+  } else {
+    const auto overlay = get_overlay<unsigned short>(goal);
+    if (overlay != nullptr) return overlay[start];
+  }
+
+  if (symmetry != NO_SYMMETRY && !is_canonical(goal_x, goal_y)) {
+    mirror(start_x, start_y);
+    mirror(goal_x, goal_y);
+  }
+
+  const size_t index = (size_t)get_slot(goal_x, goal_y) * field_size +
+                       start_x * height + start_y;
+  if (compact) {
+    const auto distance = compact_fields[index];
+    return distance == COMPACT_UNREACHABLE ? UNREACHABLE : distance;
+  }
+  return wide_fields[index];
+}
+
+template <typename T>
+unsigned short PairwiseDistances::get_derived_distance(const T *field,
+                                                       int goal_x, int goal_y,
+                                                       bool is_mirrored) const {
+  if (!(terrain[goal_x] >> goal_y & 1)) return UNREACHABLE;
+
+  // Unreachable entries are the largest value, so they never win the min.
+  T distance = numeric_limits<T>::max();
+  for (const auto &span : kernel_spans) {
+    const int x = goal_x + span.dx;
+    if (x < 0 || x >= width) continue;
+
+    const int y_lo = max(0, goal_y + span.dy_lo);
+    const int y_hi = min(height - 1, goal_y + span.dy_hi);
+    const T *row = field + x * height;
+    if (movement->n_blocked == 0) {
+      for (int y = y_lo; y <= y_hi; y++) {
+        distance = min(distance, row[y]);
+      }
+      continue;
+    }
+
+    for (int y = y_lo; y <= y_hi; y++) {
+      int cell_x = x;
+      int cell_y = y;
+      if (is_mirrored) movement->mirror(cell_x, cell_y);
+      if (movement->is_blocked(cell_x, cell_y)) continue;
+      distance = min(distance, row[y]);
+    }
+  }
+
+  if (distance == numeric_limits<T>::max()) return UNREACHABLE;
+  return distance;
+}
+
+template <typename T>
+const T *PairwiseDistances::get_overlay(int goal) const {
+  if (overlay_of_goal.empty() || overlay_of_goal[goal] == -1) return nullptr;
+  return reinterpret_cast<const T *>(overlay_fields.data()) +
+         (size_t)overlay_of_goal[goal] * field_size;
 }
 
 unsigned short PairwiseDistances::get_distance(const MapLocation &start,
@@ -102,7 +611,440 @@ unsigned short PairwiseDistances::get_distance(const MapLocation &start,
   return get_distance(start_x, start_y, goal_x, goal_y);
 }
 
-PairwiseDistances::~PairwiseDistances() { free(distances); }
+void PairwiseDistances::compute_nearest(const vector<pii> &goals,
+                                        vector<unsigned short> &distance,
+                                        vector<int> &nearest) const {
+  // Views move like their movement table, which tracks blocked cells.
+  const auto &walkable = movement != nullptr ? movement->pass : pass;
+
+  distance.assign(field_size, UNREACHABLE);
+  nearest.assign(field_size, -1);
+
+  vector<int> queue;
+  queue.reserve(field_size);
+  for (int i = 0; i < (int)goals.size(); i++) {
+    const int goal_x = goals[i].first;
+    const int goal_y = goals[i].second;
+    if (goal_x < 0 || goal_x >= width || goal_y < 0 || goal_y >= height) {
+      continue;
+    }
+    if (!(terrain[goal_x] >> goal_y & 1)) continue;
+
+    for (const auto &offset : kernel) {
+      const int x = goal_x + offset.first;
+      const int y = goal_y + offset.second;
+      if (x < 0 || x >= width || y < 0 || y >= height) continue;
+      if (!(walkable[x] >> y & 1)) continue;
+
+      const int cell = x * height + y;
+      if (nearest[cell] != -1) continue;
+      distance[cell] = 0;
+      nearest[cell] = i;
+      queue.push_back(cell);
+    }
+  }
+
+  for (size_t head = 0; head < queue.size(); head++) {
+    const int cell = queue[head];
+    const int x = cell / height;
+    const int y = cell % height;
+    for (int dx = -1; dx <= 1; dx++) {
+      const int nx = x + dx;
+      if (nx < 0 || nx >= width) continue;
+      for (int dy = -1; dy <= 1; dy++) {
+        const int ny = y + dy;
+        if (ny < 0 || ny >= height || !(walkable[nx] >> ny & 1)) continue;
+
+        const int next = nx * height + ny;
+        if (nearest[next] != -1) continue;
+        distance[next] = distance[cell] + 1;
+        nearest[next] = nearest[cell];
+        queue.push_back(next);
+      }
+    }
+  }
+}
+
+size_t PairwiseDistances::memory_usage() const {
+  return owned_fields.size() + overlay_fields.size();
+}
+
+void PairwiseDistances::block(int x, int y) {
+  assert(movement == nullptr);
+  if (!(pass[x] >> y & 1)) return;
+  pass[x] &= ~(1ull << y);
+  n_blocked++;
+
+  // Cached fields are of canonical goals, which are plain goals as well.
+  if (lazy) symmetry = NO_SYMMETRY;
+
+  if (compact) {
+    block_fields(compact_fields, x, y);
+  } else {
+    block_fields(wide_fields, x, y);
+  }
+#ifdef CHECK_DISTANCES
+  if (compact) {
+    check_repairs<uint8_t>();
+  } else {
+    check_repairs<unsigned short>();
+  }
+#endif
+}
+
+void PairwiseDistances::unblock(int x, int y) {
+  assert(movement == nullptr);
+  if (!is_blocked(x, y)) return;
+  pass[x] |= 1ull << y;
+  n_blocked--;
+
+  if (lazy) symmetry = NO_SYMMETRY;
+
+  if (compact) {
+    unblock_fields(compact_fields, x, y);
+  } else {
+    unblock_fields(wide_fields, x, y);
+  }
+#ifdef CHECK_DISTANCES
+  if (compact) {
+    check_repairs<uint8_t>();
+  } else {
+    check_repairs<unsigned short>();
+  }
+#endif
+}
+
+template <typename T>
+void PairwiseDistances::block_fields(T *fields, int x, int y) {
+  if (lazy) {
+    for (int slot = 0; slot < n_slots; slot++) {
+      const int goal = goal_of_slot[slot];
+      if (goal == -1) continue;
+      repair_block(fields + (size_t)slot * field_size, goal / height,
+                   goal % height, x, y);
+    }
+    return;
+  }
+
+  auto &cut_mask = serial_scratch.visited;
+  vector<pii> cut;
+  for (int goal_x = 0; goal_x < width; goal_x++) {
+    for (int goal_y = 0; goal_y < height; goal_y++) {
+      const int goal = goal_x * height + goal_y;
+      if (overlay_of_goal[goal] != -1) {
+        repair_block(reinterpret_cast<T *>(overlay_fields.data()) +
+                         (size_t)overlay_of_goal[goal] * field_size,
+                     goal_x, goal_y, x, y);
+        continue;
+      }
+
+      const auto read = [this, fields, goal_x, goal_y](int xx, int yy) {
+        return get_stored(fields, goal_x, goal_y, xx, yy);
+      };
+      const auto result = find_cut<T>(read, x, y, cut_mask, cut);
+      if (result == UNCHANGED) continue;
+
+      const auto field = add_overlay(fields, goal_x, goal_y);
+      if (result == CUT) {
+        settle_cut(field, cut_mask, cut);
+      } else {
+        compute_field(goal_x, goal_y, field, serial_scratch);
+#ifdef CHECK_DISTANCES
+        n_recomputed_fields++;
+#endif
+      }
+    }
+  }
+}
+
+template <typename T>
+void PairwiseDistances::unblock_fields(T *fields, int x, int y) {
+  if (lazy) {
+    for (int slot = 0; slot < n_slots; slot++) {
+      const int goal = goal_of_slot[slot];
+      if (goal == -1) continue;
+      repair_unblock(fields + (size_t)slot * field_size, goal / height,
+                     goal % height, x, y);
+    }
+    return;
+  }
+
+  const T unreachable = numeric_limits<T>::max();
+  const T max_distance = unreachable - 1;
+
+  for (int goal_x = 0; goal_x < width; goal_x++) {
+    for (int goal_y = 0; goal_y < height; goal_y++) {
+      const int goal = goal_x * height + goal_y;
+      if (overlay_of_goal[goal] != -1) {
+        repair_unblock(reinterpret_cast<T *>(overlay_fields.data()) +
+                           (size_t)overlay_of_goal[goal] * field_size,
+                       goal_x, goal_y, x, y);
+        continue;
+      }
+      if (!(terrain[goal_x] >> goal_y & 1)) continue;
+
+      // Without an overlay, every open cell has its stored distance, the one
+      // with nothing blocked, which can't get any shorter. Only (x, y) may be
+      // further away than stored, if its shortest paths went through cells
+      // that are still blocked.
+      int distance = unreachable;
+      if (in_kernel(x - goal_x, y - goal_y)) {
+        distance = 0;
+      } else {
+        for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+          const int xx = x + constants::DX[k];
+          const int yy = y + constants::DY[k];
+          if (xx < 0 || xx >= width || yy < 0 || yy >= height) continue;
+          if (!(pass[xx] >> yy & 1)) continue;
+          const int neighbour = get_stored(fields, goal_x, goal_y, xx, yy);
+          if (neighbour == unreachable) continue;
+          distance = min(distance, min(neighbour + 1, (int)max_distance));
+        }
+      }
+      if (distance == get_stored(fields, goal_x, goal_y, x, y)) continue;
+
+      repair_unblock(add_overlay(fields, goal_x, goal_y), goal_x, goal_y, x, y);
+    }
+  }
+}
+
+template <typename T>
+T PairwiseDistances::get_stored(const T *fields, int goal_x, int goal_y, int x,
+                                int y) const {
+  if (symmetry != NO_SYMMETRY && !is_canonical(goal_x, goal_y)) {
+    mirror(goal_x, goal_y);
+    mirror(x, y);
+  }
+  return fields[(size_t)get_slot(goal_x, goal_y) * field_size + x * height +
+                y];
+}
+
+template <typename T>
+T *PairwiseDistances::add_overlay(const T *fields, int goal_x, int goal_y) {
+  const int overlay = n_overlays++;
+  overlay_of_goal[goal_x * height + goal_y] = overlay;
+  overlay_fields.resize((size_t)n_overlays * field_size * sizeof(T));
+
+  T *field = reinterpret_cast<T *>(overlay_fields.data()) +
+             (size_t)overlay * field_size;
+  for (int x = 0; x < width; x++) {
+    for (int y = 0; y < height; y++) {
+      field[x * height + y] = is_blocked(x, y)
+                                  ? numeric_limits<T>::max()
+                                  : get_stored(fields, goal_x, goal_y, x, y);
+    }
+  }
+  return field;
+}
+
+template <typename T>
+void PairwiseDistances::repair_block(T *field, int goal_x, int goal_y, int x,
+                                     int y) {
+  auto &cut_mask = serial_scratch.visited;
+  vector<pii> cut;
+  const auto read = [this, field](int xx, int yy) {
+    return field[xx * height + yy];
+  };
+  const auto result = find_cut<T>(read, x, y, cut_mask, cut);
+
+  field[x * height + y] = numeric_limits<T>::max();
+  if (result == CUT) {
+    settle_cut(field, cut_mask, cut);
+  } else if (result == RECOMPUTE) {
+    compute_field(goal_x, goal_y, field, serial_scratch);
+#ifdef CHECK_DISTANCES
+    n_recomputed_fields++;
+#endif
+  }
+}
+
+template <typename T, typename Read>
+PairwiseDistances::Cut PairwiseDistances::find_cut(Read read, int x, int y,
+                                                   Rows &cut_mask,
+                                                   vector<pii> &cut) const {
+  const T unreachable = numeric_limits<T>::max();
+  const T max_distance = unreachable - 1;
+
+  cut.clear();
+  memset(cut_mask, 0, sizeof(Rows));
+
+  const int distance = read(x, y);
+  if (distance == unreachable) return UNCHANGED;
+  if (distance >= max_distance) return RECOMPUTE;
+
+  const auto is_open = [this](int xx, int yy) {
+    return xx >= 0 && xx < width && yy >= 0 && yy < height &&
+           (pass[xx] >> yy & 1);
+  };
+
+  // Cells that lost all their parents, in order of their old distance. A cell
+  // keeps its distance if a neighbour one step closer is still valid.
+  vector<pii> level = {pii(x, y)};
+  for (int level_distance = distance; !level.empty(); level_distance++) {
+    vector<pii> next_level;
+    for (const auto &cell : level) {
+      for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+        const int xx = cell.first + constants::DX[k];
+        const int yy = cell.second + constants::DY[k];
+        if (!is_open(xx, yy)) continue;
+        if (cut_mask[xx] >> yy & 1) continue;
+        if (read(xx, yy) != level_distance + 1) continue;
+
+        auto has_parent = false;
+        for (int kk = 0; kk < constants::N_DIRECTIONS_WITHOUT_CENTER; kk++) {
+          const int px = xx + constants::DX[kk];
+          const int py = yy + constants::DY[kk];
+          if (is_open(px, py) && !(cut_mask[px] >> py & 1) &&
+              read(px, py) == level_distance) {
+            has_parent = true;
+            break;
+          }
+        }
+        if (has_parent) continue;
+
+        // A saturated entry that lost its parents may now be anything from
+        // far to cut off, and so may the ones behind it.
+        if (level_distance + 1 >= max_distance) return RECOMPUTE;
+
+        cut_mask[xx] |= 1ull << yy;
+        cut.push_back(pii(xx, yy));
+        next_level.push_back(pii(xx, yy));
+      }
+    }
+    level.swap(next_level);
+  }
+  return cut.empty() ? UNCHANGED : CUT;
+}
+
+template <typename T>
+void PairwiseDistances::settle_cut(T *field, const Rows &cut_mask,
+                                   const vector<pii> &cut) const {
+  const T unreachable = numeric_limits<T>::max();
+  const T max_distance = unreachable - 1;
+
+  const auto is_open = [this](int xx, int yy) {
+    return xx >= 0 && xx < width && yy >= 0 && yy < height &&
+           (pass[xx] >> yy & 1);
+  };
+
+  // Re-settle the cut cells from their neighbours outside the cut.
+  typedef pair<int, pii> Entry;
+  priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+  for (const auto &cell : cut) {
+    int best = unreachable;
+    for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+      const int xx = cell.first + constants::DX[k];
+      const int yy = cell.second + constants::DY[k];
+      if (!is_open(xx, yy) || (cut_mask[xx] >> yy & 1)) continue;
+      const int neighbour = field[xx * height + yy];
+      if (neighbour == unreachable) continue;
+      best = min(best, min(neighbour + 1, (int)max_distance));
+    }
+    field[cell.first * height + cell.second] = unreachable;
+    if (best != unreachable) queue.push(Entry(best, cell));
+  }
+
+  while (!queue.empty()) {
+    const auto entry = queue.top();
+    queue.pop();
+    const int xx = entry.second.first;
+    const int yy = entry.second.second;
+    const T current = field[xx * height + yy];
+    if (current != unreachable && current <= entry.first) continue;
+    field[xx * height + yy] = (T)min(entry.first, (int)max_distance);
+
+    for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+      const int nx = xx + constants::DX[k];
+      const int ny = yy + constants::DY[k];
+      if (!is_open(nx, ny) || !(cut_mask[nx] >> ny & 1)) continue;
+      const T neighbour = field[nx * height + ny];
+      if (neighbour == unreachable || neighbour > entry.first + 1) {
+        queue.push(Entry(entry.first + 1, pii(nx, ny)));
+      }
+    }
+  }
+}
+
+template <typename T>
+void PairwiseDistances::repair_unblock(T *field, int goal_x, int goal_y, int x,
+                                       int y) const {
+  const T unreachable = numeric_limits<T>::max();
+  const T max_distance = unreachable - 1;
+
+  if (!(terrain[goal_x] >> goal_y & 1)) return;
+
+  int distance = unreachable;
+  if (in_kernel(x - goal_x, y - goal_y)) {
+    distance = 0;
+  } else {
+    for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+      const int xx = x + constants::DX[k];
+      const int yy = y + constants::DY[k];
+      if (xx < 0 || xx >= width || yy < 0 || yy >= height) continue;
+      const int neighbour = field[xx * height + yy];
+      if (neighbour == unreachable) continue;
+      distance = min(distance, min(neighbour + 1, (int)max_distance));
+    }
+  }
+  if (distance == unreachable) return;
+
+  // Distances only shrink, and they shrink outwards from the freed cell.
+  field[x * height + y] = (T)distance;
+  vector<pii> frontier = {pii(x, y)};
+  while (!frontier.empty()) {
+    vector<pii> next_frontier;
+    for (const auto &cell : frontier) {
+      const int next = min(field[cell.first * height + cell.second] + 1,
+                           (int)max_distance);
+      for (int k = 0; k < constants::N_DIRECTIONS_WITHOUT_CENTER; k++) {
+        const int xx = cell.first + constants::DX[k];
+        const int yy = cell.second + constants::DY[k];
+        if (xx < 0 || xx >= width || yy < 0 || yy >= height) continue;
+        if (!(pass[xx] >> yy & 1)) continue;
+        const int neighbour = field[xx * height + yy];
+        if (neighbour != unreachable && neighbour <= next) continue;
+        field[xx * height + yy] = (T)next;
+        next_frontier.push_back(pii(xx, yy));
+      }
+    }
+    frontier.swap(next_frontier);
+  }
+}
+
+#ifdef CHECK_DISTANCES
+template <typename T>
+void PairwiseDistances::check_repairs() {
+  vector<T> field(field_size);
+  for (int goal_x = 0; goal_x < width; goal_x++) {
+    for (int goal_y = 0; goal_y < height; goal_y++) {
+      compute_field(goal_x, goal_y, field.data(), serial_scratch);
+      for (int x = 0; x < width; x++) {
+        for (int y = 0; y < height; y++) {
+          const auto entry = field[x * height + y];
+          const unsigned short expected =
+              entry == numeric_limits<T>::max() ? UNREACHABLE : entry;
+          if (get_distance(x, y, goal_x, goal_y) != expected) {
+            repair_mismatches++;
+          }
+        }
+      }
+    }
+  }
+}
+#endif
+
+PairwiseDistances::~PairwiseDistances() {
+  if (mapping != nullptr) munmap(mapping, mapping_size);
+}
+
+unsigned resolve_thread_count(unsigned requested) {
+  if (requested > 0) return requested;
+
+  const char *env = getenv("DISTANCE_THREADS");
+  if (env != nullptr && atoi(env) > 0) return atoi(env);
+
+  return max(1u, thread::hardware_concurrency());
+}
 
 // Takes square distances
 vector<pair<int, int>> make_kernel(int min_distance_squared,
@@ -0,0 +1,144 @@
+#include "ReservationTable.hpp"
+#include "constants.hpp"
+
+using namespace bc;
+using namespace std;
+
+constexpr int ReservationTable::HORIZON;
+
+ReservationTable::ReservationTable(int width, int height)
+    : width(width), height(height) {}
+
+void ReservationTable::add(unsigned id, const Coord &goal,
+                           const PairwiseDistances &pd) {
+  Request request;
+  request.id = id;
+  request.goal_x = goal.get_x();
+  request.goal_y = goal.get_y();
+  request.pd = &pd;
+  request.first_step = Center;
+  requests.push_back(request);
+}
+
+unsigned ReservationTable::execute(GameState &game_state) {
+  const int n = requests.size();
+  reserved.assign((HORIZON + 1) * width * height, -1);
+  starting_at.assign(width * height, -1);
+  for (int i = 0; i < n; i++) {
+    const auto &units = game_state.my_units;
+    const int cell =
+        units.get_x(requests[i].id) * height + units.get_y(requests[i].id);
+    for (int turn = 0; turn <= HORIZON; turn++) {
+      requests[i].path[turn] = -1;
+    }
+    requests[i].path[0] = cell;
+    reservation(0, cell) = i;
+    starting_at[cell] = i;
+  }
+
+  for (int i = 0; i < n; i++) {
+    plan(game_state, i);
+  }
+
+  vector<char> state(n, PENDING);
+  unsigned n_moved = 0;
+  for (int i = 0; i < n; i++) {
+    move(game_state, i, state);
+    if (state[i] == MOVED) n_moved++;
+  }
+
+  requests.clear();
+  return n_moved;
+}
+
+void ReservationTable::plan(GameState &game_state, int request) {
+  auto &r = requests[request];
+  const auto is_move_ready = game_state.is_move_ready(r.id);
+
+  for (int turn = 1; turn <= HORIZON; turn++) {
+    const int cell = r.path[turn - 1];
+    const int x = cell / height;
+    const int y = cell % height;
+
+    // Waiting is the fallback.
+    int next = cell;
+    if (turn > 1 || is_move_ready) {
+      const auto moves = game_state.flow_fields.get_moves(
+          game_state.map_info, *r.pd, x, y, r.goal_x, r.goal_y);
+      for (int i = 0; i < moves.size(); i++) {
+        const auto dir = moves[i];
+        const int candidate =
+            (x + constants::DX[dir]) * height + y + constants::DY[dir];
+        if (!can_enter(game_state, request, turn, candidate)) continue;
+
+        next = candidate;
+        if (turn == 1) r.first_step = dir;
+        break;
+      }
+    }
+
+    r.path[turn] = next;
+    if (reservation(turn, next) == -1) reservation(turn, next) = request;
+  }
+}
+
+bool ReservationTable::can_enter(GameState &game_state, int request, int turn,
+                                 int cell) {
+  if (reservation(turn, cell) != -1) return false;
+
+  // Units that aren't planned here stay where they are. Planned ones have
+  // claimed the cell for this turn if they stay.
+  const int other = starting_at[cell];
+  if (other == -1) {
+    if (game_state.has_unit_at(cell / height, cell % height)) return false;
+  } else if (other != request) {
+    if (requests[other].path[1] == -1) return false;
+    if (turn == 1 && leads_back_to(request, other)) return false;
+  }
+
+  // Swapping with the unit coming the other way.
+  const int previous = requests[request].path[turn - 1];
+  const int from = reservation(turn - 1, cell);
+  if (from != -1 && from != request && reservation(turn, previous) == from) {
+    return false;
+  }
+
+  return true;
+}
+
+bool ReservationTable::leads_back_to(int request, int other) const {
+  // Follow the line of units making room, each moving into the cell of the
+  // next one. It must end in a free cell, not in the cell of `request`.
+  const int start = requests[request].path[0];
+  for (int i = 0; i < (int)requests.size() && other != -1; i++) {
+    const int next_cell = requests[other].path[1];
+    if (next_cell == start) return true;
+    if (next_cell == requests[other].path[0]) return false;
+    other = starting_at[next_cell];
+  }
+  return false;
+}
+
+void ReservationTable::move(GameState &game_state, int request,
+                            vector<char> &state) {
+  if (state[request] != PENDING) return;
+  state[request] = MOVING;
+
+  const auto &r = requests[request];
+  if (r.first_step == Center) {
+    state[request] = STAYED;
+    return;
+  }
+
+  // The unit ahead goes first.
+  const int other = starting_at[r.path[1]];
+  if (other != -1) move(game_state, other, state);
+
+  if (game_state.can_move(r.id, r.first_step) &&
+      game_state.is_move_ready(r.id)) {
+    game_state.move(r.id, r.first_step);
+    state[request] = MOVED;
+  } else {
+    state[request] = STAYED;
+  }
+}
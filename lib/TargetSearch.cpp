@@ -0,0 +1,86 @@
+#include "TargetSearch.hpp"
+#include <algorithm>
+
+using namespace bc;
+using namespace std;
+
+constexpr float TargetList::QUANTUM;
+
+namespace {
+
+// Keys are [quantised distance: 32 bits][index: 32 bits].
+constexpr int INDEX_BITS = 32;
+constexpr int MAX_BUCKET_BITS = 16;
+constexpr float MAX_QUANTISED = 4e9f;
+
+}  // namespace
+
+void TargetList::clear() {
+  targets.clear();
+  keys.clear();
+  max_quantised = 0;
+  is_bucketed = false;
+}
+
+void TargetList::add(float distance, uint32_t id, uint8_t x, uint8_t y) {
+  const auto scaled = distance * QUANTUM + .5f;
+  const uint64_t quantised =
+      scaled < MAX_QUANTISED ? (uint32_t)scaled : (uint32_t)MAX_QUANTISED;
+  max_quantised = max(max_quantised, quantised);
+  keys.push_back(quantised << INDEX_BITS | targets.size());
+  targets.push_back({distance, id, x, y});
+  is_bucketed = false;
+}
+
+void TargetList::distribute() {
+  // About as many buckets as keys.
+  int bucket_bits = 0;
+  while (bucket_bits < MAX_BUCKET_BITS && (1ull << bucket_bits) < keys.size()) {
+    bucket_bits++;
+  }
+  int shift = 0;
+  while ((max_quantised >> shift) >= (1ull << bucket_bits)) {
+    shift++;
+  }
+  const int n_buckets = (int)(max_quantised >> shift) + 1;
+
+  // Counting sort on the bucket, which keeps the order of addition.
+  bucket_end.assign(n_buckets + 1, 0);
+  for (const auto key : keys) {
+    bucket_end[(key >> INDEX_BITS >> shift) + 1]++;
+  }
+  for (int b = 0; b < n_buckets; b++) {
+    bucket_end[b + 1] += bucket_end[b];
+  }
+  bucketed.resize(keys.size());
+  for (const auto key : keys) {
+    bucketed[bucket_end[key >> INDEX_BITS >> shift]++] = key;
+  }
+  // bucket_end[b] now is the end of bucket b.
+
+  bucket = -1;
+  cursor = 0;
+  ordered_end = 0;
+  is_bucketed = true;
+}
+
+int TargetList::next_index() {
+  if (!is_bucketed) distribute();
+
+  while (cursor == ordered_end) {
+    if (bucket + 1 >= (int)bucket_end.size() - 1) return -1;
+    bucket++;
+    ordered_end = bucket_end[bucket];
+    sort(bucketed.begin() + cursor, bucketed.begin() + ordered_end);
+  }
+
+  const auto key = bucketed[cursor++];
+  return (int)(key & ((1ull << INDEX_BITS) - 1));
+}
+
+bool TargetList::next(Target &target) {
+  const auto index = next_index();
+  if (index == -1) return false;
+  target = targets[index];
+  return true;
+}
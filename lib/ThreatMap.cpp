@@ -0,0 +1,60 @@
+#include "ThreatMap.hpp"
+#include <algorithm>
+
+using namespace bc;
+using namespace std;
+
+constexpr uint32_t ThreatMap::MAX_AGE;
+
+ThreatMap::ThreatMap(int width, int height)
+    : width(width),
+      height(height),
+      starts(width * (height + 1)),
+      damage(width * height) {
+  for (int unit_type = 0; unit_type < constants::N_UNIT_TYPES; unit_type++) {
+    if (constants::ATTACK_DAMAGE[unit_type] == 0) continue;
+
+    auto offsets = constants::KERNEL[unit_type];
+    sort(offsets.begin(), offsets.end());
+    for (const auto &offset : offsets) {
+      auto &type_runs = runs[unit_type];
+      if (!type_runs.empty() && type_runs.back().dx == offset.first &&
+          type_runs.back().hi + 1 == offset.second) {
+        type_runs.back().hi++;
+      } else {
+        type_runs.push_back({offset.first, offset.second, offset.second});
+      }
+    }
+  }
+}
+
+void ThreatMap::update(const EnemyMemory &memory) {
+  fill(starts.begin(), starts.end(), 0);
+  for (const auto &entry : memory.sightings) {
+    const auto &sighting = entry.second;
+    if (memory.get_age(sighting) > MAX_AGE) continue;
+    stamp(sighting.unit_type, sighting.x, sighting.y);
+  }
+
+  for (int x = 0; x < width; x++) {
+    const auto column = &starts[x * (height + 1)];
+    int sum = 0;
+    for (int y = 0; y < height; y++) {
+      sum += column[y];
+      damage[x * height + y] = sum;
+    }
+  }
+}
+
+void ThreatMap::stamp(UnitType unit_type, int x, int y) {
+  const int value = constants::ATTACK_DAMAGE[unit_type];
+  for (const auto &run : runs[unit_type]) {
+    const auto xx = x + run.dx;
+    if (xx < 0 || xx >= width) continue;
+    const auto lo = max(0, y + run.lo);
+    const auto hi = min(height - 1, y + run.hi);
+    if (lo > hi) continue;
+    starts[xx * (height + 1) + lo] += value;
+    starts[xx * (height + 1) + hi + 1] -= value;
+  }
+}
@@ -0,0 +1,37 @@
+#include "UnitCache.hpp"
+
+using namespace bc;
+using namespace std;
+
+const UnitSnapshot &UnitCache::get(GameController &gc, unsigned id) {
+  const auto it = snapshots.find(id);
+  if (it != snapshots.end()) return it->second;
+
+  const auto unit = gc.get_unit(id);
+  auto &snapshot = snapshots[id];
+  snapshot.unit_type = unit.get_unit_type();
+  snapshot.health = unit.get_health();
+  snapshot.max_health = unit.get_max_health();
+  if (unit.is_robot()) {
+    snapshot.movement_heat = unit.get_movement_heat();
+    snapshot.attack_heat = unit.get_attack_heat();
+    snapshot.attack_cooldown = unit.get_attack_cooldown();
+    snapshot.ability_heat = unit.get_ability_heat();
+    snapshot.has_acted =
+        snapshot.unit_type == Worker && unit.worker_has_acted();
+    snapshot.is_built = true;
+  } else {
+    snapshot.movement_heat = 0;
+    snapshot.attack_heat = 0;
+    snapshot.attack_cooldown = 0;
+    snapshot.ability_heat = 0;
+    snapshot.has_acted = false;
+    snapshot.is_built = unit.structure_is_built();
+    snapshot.garrison = unit.get_structure_garrison();
+  }
+  return snapshot;
+}
+
+void UnitCache::invalidate(unsigned id) { snapshots.erase(id); }
+
+void UnitCache::clear() { snapshots.clear(); }
@@ -5,96 +5,191 @@ UnitList::UnitList(GameController& gc, const Team& team)
       PLANET(gc.get_planet()),
       WIDTH(gc.get_starting_planet(PLANET).get_width()),
       HEIGHT(gc.get_starting_planet(PLANET).get_height()),
-      by_location(WIDTH, vector<unsigned>(HEIGHT)),
-      is_occupied(WIDTH, vector<bool>(HEIGHT)) {
+      by_location(WIDTH * HEIGHT),
+      occupied(WIDTH, HEIGHT) {
   const auto planet_map = gc.get_starting_planet(gc.get_planet());
   for (const auto& unit : planet_map.get_initial_units()) {
     if (unit.get_team() == TEAM) {
       const auto id = unit.get_id();
-      const auto loc = unit.get_map_location();
-      initial_workers[id] = loc;
+      initial_workers[id] = Coord(unit.get_map_location());
     }
   }
 }
 
-void UnitList::add(unsigned id, UnitType unit_type, MapLocation loc) {
-  const auto x = loc.get_x();
-  const auto y = loc.get_y();
+void UnitList::add(unsigned id, UnitType unit_type, int x, int y) {
+  const int slot = ids.size();
+  ids.push_back(id);
+  types.push_back(unit_type);
+  xs.push_back(x);
+  ys.push_back(y);
+  healths.push_back({0, 0});
+  flags.push_back(0);
+  type_index.push_back(type_slots[unit_type].size());
+  type_slots[unit_type].push_back(slot);
+  slot_of_id[id] = slot;
+
+  by_location[x * HEIGHT + y] = id;
+  occupied.set(x, y);
+}
 
-  by_id[id] = make_pair(unit_type, loc);
-  by_type[unit_type].insert(id);
-  by_location[x][y] = id;
-  is_occupied[x][y] = true;
-  all.insert(id);
+void UnitList::add(unsigned id, UnitType unit_type, const Coord& loc) {
+  add(id, unit_type, loc.get_x(), loc.get_y());
 }
 
 void UnitList::remove(unsigned id) {
-  const auto type_loc_pair = by_id[id];
-  const auto unit_type = type_loc_pair.first;
-  const auto x = type_loc_pair.second.get_x();
-  const auto y = type_loc_pair.second.get_y();
-
-  by_id.erase(id);
-  by_location[x][y] = -1;
-  is_occupied[x][y] = false;
-  by_type[unit_type].erase(id);
-  all.erase(id);
+  const int slot = get_slot(id);
+  const auto x = xs[slot];
+  const auto y = ys[slot];
+
+  occupied.reset(x, y);
+
+  // Swap with the last slot of the same type, then with the last slot.
+  auto& same_type = type_slots[types[slot]];
+  const int moved_within_type = same_type.back();
+  same_type[type_index[slot]] = moved_within_type;
+  type_index[moved_within_type] = type_index[slot];
+  same_type.pop_back();
+
+  const int last = ids.size() - 1;
+  if (slot != last) {
+    ids[slot] = ids[last];
+    types[slot] = types[last];
+    xs[slot] = xs[last];
+    ys[slot] = ys[last];
+    healths[slot] = healths[last];
+    flags[slot] = flags[last];
+    type_index[slot] = type_index[last];
+    type_slots[types[slot]][type_index[slot]] = slot;
+    slot_of_id[ids[slot]] = slot;
+  }
+  ids.pop_back();
+  types.pop_back();
+  xs.pop_back();
+  ys.pop_back();
+  healths.pop_back();
+  flags.pop_back();
+  type_index.pop_back();
+  slot_of_id.erase(id);
 }
 
 void UnitList::move(unsigned id, Direction dir) {
-  const auto type_loc_pair = by_id[id];
-  const auto unit_type = type_loc_pair.first;
+  const int slot = get_slot(id);
+  const auto prev_x = xs[slot];
+  const auto prev_y = ys[slot];
+  const auto curr_x = prev_x + constants::DX[dir];
+  const auto curr_y = prev_y + constants::DY[dir];
+
+  xs[slot] = curr_x;
+  ys[slot] = curr_y;
+  occupied.reset(prev_x, prev_y);
+
+  by_location[curr_x * HEIGHT + curr_y] = id;
+  occupied.set(curr_x, curr_y);
+}
 
-  const auto prev_loc = type_loc_pair.second;
-  const auto prev_x = prev_loc.get_x();
-  const auto prev_y = prev_loc.get_y();
+vector<unsigned> UnitList::get_ids(UnitType unit_type) const {
+  vector<unsigned> result;
+  result.reserve(type_slots[unit_type].size());
+  for (const auto slot : type_slots[unit_type]) {
+    result.push_back(ids[slot]);
+  }
+  return result;
+}
 
-  const auto curr_loc = prev_loc.add(dir);
-  const auto curr_x = curr_loc.get_x();
-  const auto curr_y = curr_loc.get_y();
+void UnitList::clear() {
+  ids.clear();
+  types.clear();
+  xs.clear();
+  ys.clear();
+  healths.clear();
+  flags.clear();
+  type_index.clear();
+  slot_of_id.clear();
 
-  by_id[id] = make_pair(unit_type, curr_loc);
-  by_location[prev_x][prev_y] = -1;
-  is_occupied[prev_x][prev_y] = false;
+  for (int i = 0; i < constants::N_UNIT_TYPES; i++) {
+    type_slots[i].clear();
+  }
 
-  by_location[curr_x][curr_y] = id;
-  is_occupied[curr_x][curr_y] = true;
+  occupied.clear();
 }
 
-void UnitList::update(GameController& gc) {
-  all.clear();
-  by_id.clear();
+void UnitList::add_sensed(const Unit& unit, const MapLocation& loc) {
+  const auto id = unit.get_id();
+  add(id, unit.get_unit_type(), loc.get_x(), loc.get_y());
+  const int slot = ids.size() - 1;
+  healths[slot] = {unit.get_health(), unit.get_max_health()};
+  flags[slot] |= SENSED;
+  if (initial_workers.count(id)) {
+    initial_workers.erase(id);
+  }
+}
 
-  for (int i = 0; i < constants::N_UNIT_TYPES; i++) {
-    by_type[i].clear();
+void UnitList::add_unseen_initial_units() {
+  for (const auto& worker : initial_workers) {
+    const auto id = worker.first;
+    const auto loc = worker.second;
+    add(id, Worker, loc);
   }
+}
+
+void UnitList::update(GameController& gc, UnitList& a, UnitList& b) {
+  a.clear();
+  b.clear();
+
+  for (const auto& unit : gc.get_units()) {
+    // Units in garrisons and in space are not on the map.
+    const auto location = unit.get_location();
+    if (!location.is_on_planet(a.PLANET)) continue;
+
+    const auto team = unit.get_team();
+    if (team == a.TEAM) {
+      a.add_sensed(unit, location.get_map_location());
+    } else if (team == b.TEAM) {
+      b.add_sensed(unit, location.get_map_location());
+    }
+  }
+
+  a.add_unseen_initial_units();
+  b.add_unseen_initial_units();
+}
+
+void UnitList::update_by_probing(GameController& gc) {
+  clear();
 
   for (int i = 0; i < (int)WIDTH; i++) {
     for (int j = 0; j < (int)HEIGHT; j++) {
       MapLocation ml(PLANET, i, j);
 
-      is_occupied[i][j] = false;
-      by_location[i][j] = -1;
-
       if (gc.can_sense_location(ml)) {
         if (gc.has_unit_at_location(ml)) {
           auto unit = gc.sense_unit_at_location(ml);
           if (unit.get_team() == TEAM) {
-            const auto id = unit.get_id();
-            add(id, unit.get_unit_type(), ml);
-            if (initial_workers.count(id)) {
-              initial_workers.erase(id);
-            }
+            add_sensed(unit, ml);
           }
         }
       }
     }
   }
 
-  // Insert initial units that haven't been seen yet.
-  for (const auto& worker : initial_workers) {
-    const auto id = worker.first;
-    const auto loc = worker.second;
-    add(id, Worker, loc);
+  add_unseen_initial_units();
+}
+
+void UnitList::find_within(int x, int y, unsigned radius_squared,
+                           vector<unsigned>& found) const {
+  found.clear();
+  int radius = 0;
+  while ((unsigned)((radius + 1) * (radius + 1)) <= radius_squared) radius++;
+
+  const auto around = BitGrid::span(y, radius);
+  const int x_lo = max(0, x - radius);
+  const int x_hi = min((int)WIDTH - 1, x + radius);
+  for (int cx = x_lo; cx <= x_hi; cx++) {
+    for (auto bits = occupied.row(cx) & around; bits; bits &= bits - 1) {
+      const int cy = __builtin_ctzll(bits) - 1;
+      const int dx = cx - x;
+      const int dy = cy - y;
+      if ((unsigned)(dx * dx + dy * dy) > radius_squared) continue;
+      found.push_back(get_id_at(cx, cy));
+    }
   }
 }
@@ -0,0 +1,365 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "World.hpp"
+#include "bc.hpp"
+
+using namespace bc;
+using namespace std;
+
+namespace {
+
+const char *DEFAULT_MAP = "sim/maps/default.map";
+
+// What the engine adds to the time pool on every turn.
+const double TIME_PER_TURN_MS = 50;
+
+double get_ms_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Like the engine, invalid actions are logged and do nothing.
+void log_invalid(sim::World &world, const char *action) {
+  world.n_errors++;
+  cerr << "Simulator: round " << world.round << ": invalid " << action << endl;
+}
+
+void print_summary(const sim::World &world) {
+  // The team that lasted longer, or the one with the most valuable units.
+  const auto &eliminated = world.eliminated_round;
+  Team winner;
+  if (eliminated[Red] != eliminated[Blue]) {
+    winner = eliminated[Red] == 0 || (eliminated[Blue] != 0 &&
+                                      eliminated[Red] > eliminated[Blue])
+                 ? Red
+                 : Blue;
+  } else {
+    winner = world.get_score(Red) >= world.get_score(Blue) ? Red : Blue;
+  }
+
+  cerr << "Simulator: " << (winner == Red ? "Red" : "Blue") << " wins" << endl;
+  for (const auto team : {Red, Blue}) {
+    cerr << "  " << (team == Red ? "Red" : "Blue") << ": "
+         << world.get_ids(team).size() << " units, score "
+         << world.get_score(team) << ", karbonite " << world.karbonite[team];
+    if (eliminated[team] != 0) {
+      cerr << ", wiped out on round " << eliminated[team];
+    }
+    cerr << endl;
+  }
+  cerr << "  Invalid actions: " << world.n_errors << endl;
+  cerr << "  Bot time: " << world.total_turn_ms << " ms, at most "
+       << world.max_turn_ms << " ms per turn, " << world.n_timeouts
+       << " turns over the time pool" << endl;
+  cerr << "  Simulation time: " << world.simulation_ms << " ms" << endl;
+}
+
+}  // namespace
+
+namespace bc {
+
+GameController::GameController() {
+  const auto map_path = getenv("BC_MAP");
+  const auto seed = getenv("BC_SEED");
+  m_world.reset(new sim::World(map_path != nullptr ? map_path : DEFAULT_MAP,
+                               seed != nullptr ? atoi(seed) : 0));
+  m_world->turn_start = chrono::steady_clock::now();
+}
+
+GameController::~GameController() {}
+
+void GameController::next_turn() const {
+  auto &world = *m_world;
+  const auto turn_ms = get_ms_since(world.turn_start);
+  world.total_turn_ms += turn_ms;
+  world.max_turn_ms = max(world.max_turn_ms, turn_ms);
+  world.time_pool_ms += TIME_PER_TURN_MS - turn_ms;
+  if (world.time_pool_ms < 0) world.n_timeouts++;
+
+  const auto simulation_start = chrono::steady_clock::now();
+  const auto is_running = world.end_round();
+  world.simulation_ms += get_ms_since(simulation_start);
+  if (!is_running) {
+    print_summary(world);
+    exit(0);
+  }
+  world.turn_start = chrono::steady_clock::now();
+}
+
+unsigned GameController::get_round() const { return m_world->round; }
+
+Planet GameController::get_planet() const { return Earth; }
+
+Team GameController::get_team() const { return Red; }
+
+const PlanetMap &GameController::get_starting_planet(Planet planet) {
+  return m_world->maps[planet];
+}
+
+unsigned GameController::get_karbonite() const {
+  return m_world->karbonite[Red];
+}
+
+unsigned GameController::get_time_left_ms() const {
+  const auto left =
+      m_world->time_pool_ms - get_ms_since(m_world->turn_start);
+  return left > 0 ? left : 0;
+}
+
+bool GameController::has_unit(unsigned id) const {
+  const auto &world = *m_world;
+  if (!world.is_alive(id)) return false;
+  const auto &unit = world.get(id);
+  if (unit.get_team() == Red) return true;
+  const auto location = unit.get_location();
+  return location.is_on_map() &&
+         world.is_visible(Red, location.get_map_location());
+}
+
+Unit GameController::get_unit(unsigned id) const {
+  if (!has_unit(id)) {
+    log_invalid(*m_world, "get_unit");
+    return Unit();
+  }
+  return m_world->get(id);
+}
+
+vector<Unit> GameController::get_units() const {
+  vector<Unit> units;
+  for (const auto &record : m_world->records) {
+    if (record.is_alive && has_unit(record.unit.get_id())) {
+      units.push_back(record.unit);
+    }
+  }
+  return units;
+}
+
+unsigned GameController::get_karbonite_at(const MapLocation &loc) const {
+  if (!can_sense_location(loc)) {
+    log_invalid(*m_world, "get_karbonite_at");
+    return 0;
+  }
+  return m_world->karbonite_at[loc.get_planet()][m_world->index(loc)];
+}
+
+bool GameController::can_sense_location(const MapLocation &loc) const {
+  return m_world->is_visible(Red, loc);
+}
+
+bool GameController::has_unit_at_location(const MapLocation &loc) const {
+  return can_sense_location(loc) && m_world->get_unit_at(loc) != 0;
+}
+
+Unit GameController::sense_unit_at_location(const MapLocation &loc) const {
+  if (!has_unit_at_location(loc)) {
+    log_invalid(*m_world, "sense_unit_at_location");
+    return Unit();
+  }
+  return m_world->get(m_world->get_unit_at(loc));
+}
+
+// Our units only, and targets in sight.
+
+bool GameController::is_mine(unsigned id) const {
+  return m_world->is_alive(id) && m_world->get(id).get_team() == Red;
+}
+
+void GameController::disintegrate_unit(unsigned id) const {
+  if (!is_mine(id)) return log_invalid(*m_world, "disintegrate_unit");
+  m_world->disintegrate(id);
+}
+
+bool GameController::can_move(unsigned id, Direction direction) const {
+  return is_mine(id) && m_world->can_move(id, direction);
+}
+
+bool GameController::is_move_ready(unsigned id) const {
+  return is_mine(id) && m_world->is_move_ready(id);
+}
+
+void GameController::move_robot(unsigned id, Direction direction) const {
+  if (!can_move(id, direction) || !is_move_ready(id)) {
+    return log_invalid(*m_world, "move_robot");
+  }
+  m_world->move(id, direction);
+}
+
+bool GameController::can_attack(unsigned id, unsigned target_id) const {
+  return is_mine(id) && has_unit(target_id) &&
+         m_world->can_attack(id, target_id);
+}
+
+bool GameController::is_attack_ready(unsigned id) const {
+  return is_mine(id) && m_world->is_attack_ready(id);
+}
+
+void GameController::attack(unsigned id, unsigned target_id) const {
+  if (!can_attack(id, target_id) || !is_attack_ready(id)) {
+    return log_invalid(*m_world, "attack");
+  }
+  m_world->attack(id, target_id);
+}
+
+bool GameController::queue_research(UnitType branch) const {
+  return m_world->queue_research(Red, branch);
+}
+
+bool GameController::can_harvest(unsigned id, Direction direction) const {
+  return is_mine(id) && m_world->can_harvest(id, direction);
+}
+
+void GameController::harvest(unsigned id, Direction direction) const {
+  if (!can_harvest(id, direction)) return log_invalid(*m_world, "harvest");
+  m_world->harvest(id, direction);
+}
+
+bool GameController::can_blueprint(unsigned id, UnitType unit_type,
+                                   Direction direction) const {
+  return is_mine(id) && m_world->can_blueprint(id, unit_type, direction);
+}
+
+void GameController::blueprint(unsigned id, UnitType unit_type,
+                               Direction direction) const {
+  if (!can_blueprint(id, unit_type, direction)) {
+    return log_invalid(*m_world, "blueprint");
+  }
+  m_world->blueprint(id, unit_type, direction);
+}
+
+bool GameController::can_build(unsigned worker_id,
+                               unsigned blueprint_id) const {
+  return is_mine(worker_id) && m_world->can_build(worker_id, blueprint_id);
+}
+
+void GameController::build(unsigned worker_id, unsigned blueprint_id) const {
+  if (!can_build(worker_id, blueprint_id)) {
+    return log_invalid(*m_world, "build");
+  }
+  m_world->build(worker_id, blueprint_id);
+}
+
+bool GameController::can_repair(unsigned worker_id,
+                                unsigned structure_id) const {
+  return is_mine(worker_id) && m_world->can_repair(worker_id, structure_id);
+}
+
+void GameController::repair(unsigned worker_id, unsigned structure_id) const {
+  if (!can_repair(worker_id, structure_id)) {
+    return log_invalid(*m_world, "repair");
+  }
+  m_world->repair(worker_id, structure_id);
+}
+
+bool GameController::can_replicate(unsigned worker_id,
+                                   Direction direction) const {
+  return is_mine(worker_id) && m_world->can_replicate(worker_id, direction);
+}
+
+void GameController::replicate(unsigned worker_id, Direction direction) const {
+  if (!can_replicate(worker_id, direction)) {
+    return log_invalid(*m_world, "replicate");
+  }
+  m_world->replicate(worker_id, direction);
+}
+
+bool GameController::can_javelin(unsigned knight_id,
+                                 unsigned target_id) const {
+  return is_mine(knight_id) && has_unit(target_id) &&
+         m_world->can_javelin(knight_id, target_id);
+}
+
+bool GameController::is_javelin_ready(unsigned knight_id) const {
+  return is_mine(knight_id) && m_world->is_javelin_ready(knight_id);
+}
+
+void GameController::javelin(unsigned knight_id, unsigned target_id) const {
+  if (!can_javelin(knight_id, target_id) || !is_javelin_ready(knight_id)) {
+    return log_invalid(*m_world, "javelin");
+  }
+  m_world->javelin(knight_id, target_id);
+}
+
+bool GameController::can_heal(unsigned healer_id, unsigned target_id) const {
+  return is_mine(healer_id) && m_world->can_heal(healer_id, target_id);
+}
+
+bool GameController::is_heal_ready(unsigned healer_id) const {
+  return is_mine(healer_id) && m_world->is_heal_ready(healer_id);
+}
+
+void GameController::heal(unsigned healer_id, unsigned target_id) const {
+  if (!can_heal(healer_id, target_id) || !is_heal_ready(healer_id)) {
+    return log_invalid(*m_world, "heal");
+  }
+  m_world->heal(healer_id, target_id);
+}
+
+bool GameController::can_overcharge(unsigned healer_id,
+                                    unsigned target_id) const {
+  return is_mine(healer_id) && m_world->can_overcharge(healer_id, target_id);
+}
+
+bool GameController::is_overcharge_ready(unsigned healer_id) const {
+  return is_mine(healer_id) && m_world->is_overcharge_ready(healer_id);
+}
+
+void GameController::overcharge(unsigned healer_id,
+                                unsigned target_id) const {
+  if (!can_overcharge(healer_id, target_id) ||
+      !is_overcharge_ready(healer_id)) {
+    return log_invalid(*m_world, "overcharge");
+  }
+  m_world->overcharge(healer_id, target_id);
+}
+
+bool GameController::can_load(unsigned structure_id, unsigned robot_id) const {
+  return is_mine(structure_id) && m_world->can_load(structure_id, robot_id);
+}
+
+void GameController::load(unsigned structure_id, unsigned robot_id) const {
+  if (!can_load(structure_id, robot_id)) return log_invalid(*m_world, "load");
+  m_world->load(structure_id, robot_id);
+}
+
+bool GameController::can_unload(unsigned structure_id,
+                                Direction direction) const {
+  return is_mine(structure_id) && m_world->can_unload(structure_id, direction);
+}
+
+void GameController::unload(unsigned structure_id, Direction direction) const {
+  if (!can_unload(structure_id, direction)) {
+    return log_invalid(*m_world, "unload");
+  }
+  m_world->unload(structure_id, direction);
+}
+
+bool GameController::can_produce_robot(unsigned factory_id,
+                                       UnitType unit_type) const {
+  return is_mine(factory_id) &&
+         m_world->can_produce_robot(factory_id, unit_type);
+}
+
+void GameController::produce_robot(unsigned factory_id,
+                                   UnitType unit_type) const {
+  if (!can_produce_robot(factory_id, unit_type)) {
+    return log_invalid(*m_world, "produce_robot");
+  }
+  m_world->produce_robot(factory_id, unit_type);
+}
+
+bool GameController::can_launch_rocket(unsigned rocket_id,
+                                       const MapLocation &loc) const {
+  return is_mine(rocket_id) && m_world->can_launch_rocket(rocket_id, loc);
+}
+
+void GameController::launch_rocket(unsigned rocket_id,
+                                   const MapLocation &loc) const {
+  if (!can_launch_rocket(rocket_id, loc)) {
+    return log_invalid(*m_world, "launch_rocket");
+  }
+  m_world->launch_rocket(rocket_id, loc);
+}
+
+}  // namespace bc
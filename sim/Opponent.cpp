@@ -0,0 +1,171 @@
+#include "World.hpp"
+
+#include "constants.hpp"
+
+using namespace std;
+
+// Blue plays a plain rush: workers mine, replicate and put up factories,
+// which pour out knights and rangers that walk at the nearest Red unit.
+// Greedy steps, no pathfinding, and it sees the whole map.
+
+namespace sim {
+
+namespace {
+
+const unsigned MAX_WORKERS = 6;
+const unsigned MAX_FACTORIES = 3;
+
+// The unit on the map nearest to `id` among those `predicate` picks, or 0.
+template <typename Predicate>
+unsigned find_nearest(const World &world, unsigned id, Predicate predicate) {
+  unsigned nearest = 0;
+  int nearest_distance = numeric_limits<int>::max();
+  for (unsigned other_id = 1; other_id < world.records.size(); other_id++) {
+    if (other_id == id || !world.is_alive(other_id)) continue;
+    if (!predicate(world.get(other_id))) continue;
+    const auto distance = world.distance_squared(id, other_id);
+    if (distance != -1 && distance < nearest_distance) {
+      nearest_distance = distance;
+      nearest = other_id;
+    }
+  }
+  return nearest;
+}
+
+// The Earth cell nearest to `loc` with karbonite left, if any.
+bool find_nearest_karbonite(const World &world, const MapLocation &loc,
+                            MapLocation &nearest) {
+  const auto &map = world.maps[Earth];
+  unsigned nearest_distance = numeric_limits<unsigned>::max();
+  for (int x = 0; x < (int)map.get_width(); x++) {
+    for (int y = 0; y < (int)map.get_height(); y++) {
+      const MapLocation deposit(Earth, x, y);
+      if (world.karbonite_at[Earth][world.index(deposit)] == 0) continue;
+      const auto distance = loc.distance_squared_to(deposit);
+      if (distance < nearest_distance) {
+        nearest_distance = distance;
+        nearest = deposit;
+      }
+    }
+  }
+  return nearest_distance != numeric_limits<unsigned>::max();
+}
+
+}  // namespace
+
+void World::play_opponent() {
+  unsigned n_workers = 0;
+  unsigned n_factories = 0;
+  const auto ids = get_ids(Blue);
+  for (const auto id : ids) {
+    if (get(id).unit_type == Worker) n_workers++;
+    if (get(id).unit_type == Factory) n_factories++;
+  }
+
+  uniform_int_distribution<int> random_direction(
+      0, constants::N_DIRECTIONS_WITHOUT_CENTER - 1);
+
+  for (const auto id : ids) {
+    if (!is_alive(id) || !get(id).location.is_on_map()) continue;
+    const auto unit_type = get(id).unit_type;
+    const auto loc = get(id).location.get_map_location();
+
+    switch (unit_type) {
+      case Factory: {
+        for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
+          const auto dir = static_cast<Direction>(i);
+          if (can_unload(id, dir)) unload(id, dir);
+        }
+        const auto robot_type = rng() % 2 ? Knight : Ranger;
+        if (can_produce_robot(id, robot_type)) produce_robot(id, robot_type);
+      } break;
+
+      case Worker: {
+        for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
+          const auto other_id = get_unit_at(loc.add(static_cast<Direction>(i)));
+          if (other_id != 0 && can_build(id, other_id)) build(id, other_id);
+        }
+
+        const auto dir = static_cast<Direction>(random_direction(rng));
+        if (n_factories < MAX_FACTORIES && can_blueprint(id, Factory, dir)) {
+          blueprint(id, Factory, dir);
+          n_factories++;
+        } else if (n_workers < MAX_WORKERS && can_replicate(id, dir)) {
+          replicate(id, dir);
+          n_workers++;
+        }
+
+        for (int i = 0; i < constants::N_DIRECTIONS; i++) {
+          const auto harvest_dir = static_cast<Direction>(i);
+          if (can_harvest(id, harvest_dir)) harvest(id, harvest_dir);
+        }
+
+        if (!is_move_ready(id)) break;
+        // Finish the blueprints first.
+        const auto blueprint_id =
+            find_nearest(*this, id, [](const Unit &other) {
+              return other.get_team() == Blue && !other.structure_is_built();
+            });
+        MapLocation deposit;
+        if (blueprint_id != 0) {
+          if (distance_squared(id, blueprint_id) > 2) {
+            step_towards(id, get(blueprint_id).location.get_map_location());
+          }
+        } else if (find_nearest_karbonite(*this, loc, deposit) &&
+                   loc.distance_squared_to(deposit) > 2) {
+          step_towards(id, deposit);
+        } else if (can_move(id, dir)) {
+          move(id, dir);
+        }
+      } break;
+
+      case Knight:
+      case Ranger:
+      case Mage: {
+        const auto target_id = find_nearest(*this, id, [](const Unit &other) {
+          return other.get_team() == Red;
+        });
+        if (target_id == 0) break;
+        if (is_attack_ready(id) && can_attack(id, target_id)) {
+          attack(id, target_id);
+        }
+        if (is_move_ready(id) &&
+            step_towards(id, get(target_id).location.get_map_location()) &&
+            is_alive(target_id) && is_attack_ready(id) &&
+            can_attack(id, target_id)) {
+          attack(id, target_id);
+        }
+      } break;
+
+      default:
+        break;
+    }
+  }
+}
+
+bool World::step_towards(unsigned id, const MapLocation& goal) {
+  const auto loc = get(id).location.get_map_location();
+  auto best_distance = loc.distance_squared_to(goal);
+  auto best_dir = Center;
+  for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
+    const auto dir = static_cast<Direction>(i);
+    if (!can_move(id, dir)) continue;
+    const auto distance = loc.add(dir).distance_squared_to(goal);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best_dir = dir;
+    }
+  }
+
+  // Stuck against something: wander off.
+  if (best_dir == Center) {
+    const auto dir = static_cast<Direction>(
+        rng() % constants::N_DIRECTIONS_WITHOUT_CENTER);
+    if (!can_move(id, dir)) return false;
+    best_dir = dir;
+  }
+  move(id, best_dir);
+  return true;
+}
+
+}  // namespace sim
@@ -0,0 +1,753 @@
+#include "World.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "constants.hpp"
+
+using namespace std;
+
+namespace {
+
+struct UnitStats {
+  unsigned health;
+  unsigned vision_range;
+  unsigned movement_cooldown;
+  unsigned attack_cooldown;
+  unsigned ability_cooldown;
+};
+
+// From the specs. Plain arrays, so that they are set before the tables of
+// constants.hpp are built from them.
+const UnitStats STATS[] = {
+    {100, 50, 20, 0, 50},     // Worker
+    {250, 50, 15, 20, 100},   // Knight
+    {200, 70, 20, 20, 200},   // Ranger
+    {80, 30, 20, 20, 250},    // Mage
+    {100, 50, 25, 10, 100},   // Healer
+    {300, 2, 0, 0, 0},        // Factory
+    {200, 2, 0, 0, 0},        // Rocket
+};
+const unsigned FACTORY_COST[] = {50, 40, 40, 40, 40, 0, 0};
+const unsigned BLUEPRINT_COST[] = {0, 0, 0, 0, 0, 200, 150};
+const unsigned REPLICATE_COST = 60;
+const unsigned RESEARCH_COST[][4] = {
+    {25, 75, 75, 75},   // Worker
+    {25, 75, 100, 0},   // Knight
+    {25, 100, 200, 0},  // Ranger
+    {25, 75, 100, 75},  // Mage
+    {25, 100, 100, 0},  // Healer
+    {0, 0, 0, 0},       // Factory
+    {50, 100, 100, 0},  // Rocket
+};
+
+const unsigned BUILD_HEALTH = 5;
+const unsigned REPAIR_HEALTH = 10;
+const unsigned HARVEST_AMOUNT = 3;
+const unsigned HEAL_AMOUNT = 10;
+const unsigned KNIGHT_DEFENSE = 5;
+const unsigned ROCKET_BLAST_DAMAGE = 50;
+const unsigned GARRISON_CAPACITY = 8;
+const unsigned FACTORY_ROUNDS = 5;
+const unsigned KARBONITE_PER_ROUND = 10;
+// One less karbonite per round for every this much in the bank.
+const unsigned KARBONITE_DECREASE_DIVISOR = 40;
+
+// Research levels that unlock something.
+const unsigned JAVELIN_LEVEL = 3;
+const unsigned OVERCHARGE_LEVEL = 3;
+const unsigned ROCKET_LEVEL = 1;
+
+}  // namespace
+
+unsigned cost_of(bc_UnitType branch, unsigned level) {
+  if (level < 1 || level > 4 || RESEARCH_COST[branch][level - 1] == 0) {
+    return numeric_limits<unsigned>::max();
+  }
+  return RESEARCH_COST[branch][level - 1];
+}
+
+namespace bc {
+
+unsigned unit_type_get_factory_cost(UnitType unit_type) {
+  return FACTORY_COST[unit_type];
+}
+
+unsigned unit_type_get_blueprint_cost(UnitType unit_type) {
+  return BLUEPRINT_COST[unit_type];
+}
+
+unsigned unit_type_get_replicate_cost() { return REPLICATE_COST; }
+
+unsigned unit_type_get_value(UnitType unit_type) {
+  return is_structure(unit_type) ? BLUEPRINT_COST[unit_type]
+                                 : FACTORY_COST[unit_type];
+}
+
+}  // namespace bc
+
+namespace sim {
+
+constexpr unsigned World::ROCKET_TRAVEL_TIME;
+constexpr unsigned World::STARTING_KARBONITE;
+constexpr unsigned World::N_RESEARCH_BRANCHES;
+
+World::World(const string &map_path, unsigned seed) : rng(seed) {
+  karbonite.fill(STARTING_KARBONITE);
+  research_progress.fill(0);
+  eliminated_round.fill(0);
+  for (auto &levels : research_level) levels.fill(0);
+  // Ids start at 1, 0 marks empty cells.
+  records.resize(1);
+  records[0].is_alive = false;
+  load_map(map_path);
+}
+
+void World::load_map(const string &map_path) {
+  const auto fail = [&](const string &message) {
+    cerr << "Simulator: " << map_path << ": " << message << endl;
+    exit(1);
+  };
+
+  ifstream file(map_path);
+  if (!file) fail("cannot open the map");
+
+  // Earth, then optionally Mars, separated by a blank line.
+  vector<vector<string>> sections(1);
+  string line;
+  while (getline(file, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty()) {
+      if (!sections.back().empty()) sections.emplace_back();
+      continue;
+    }
+    sections.back().push_back(line);
+  }
+  if (sections.back().empty()) sections.pop_back();
+  if (sections.empty() || sections.size() > 2) {
+    fail("expected an Earth grid and an optional Mars grid");
+  }
+  // Without one, Mars is open ground of the size of Earth.
+  if (sections.size() == 1) {
+    sections.push_back(vector<string>(
+        sections[0].size(), string(sections[0][0].size(), '.')));
+  }
+
+  vector<pair<Team, MapLocation>> initial_workers;
+  for (int p = 0; p < 2; p++) {
+    const auto planet = static_cast<Planet>(p);
+    const auto &rows = sections[p];
+    const int width = rows[0].size();
+    const int height = rows.size();
+    if (width < constants::MIN_MAP_SIZE || width > constants::MAX_MAP_SIZE ||
+        height < constants::MIN_MAP_SIZE ||
+        height > constants::MAX_MAP_SIZE) {
+      fail("maps are from " + to_string(constants::MIN_MAP_SIZE) + " to " +
+           to_string(constants::MAX_MAP_SIZE) + " cells wide and high");
+    }
+
+    auto &map = maps[p];
+    map.m_planet = planet;
+    map.m_width = width;
+    map.m_height = height;
+    map.m_passable.assign(width * height, true);
+    map.m_karbonite.assign(width * height, 0);
+    unit_at[p].assign(width * height, 0);
+
+    // The first row is the top one, North being up.
+    for (int row = 0; row < height; row++) {
+      if ((int)rows[row].size() != width) fail("rows differ in length");
+      const int y = height - 1 - row;
+      for (int x = 0; x < width; x++) {
+        const auto c = rows[row][x];
+        const auto i = x * height + y;
+        if (c == '#') {
+          map.m_passable[i] = false;
+        } else if (c >= '1' && c <= '9') {
+          map.m_karbonite[i] = (c - '0') * 10;
+        } else if ((c == 'r' || c == 'b') && planet == Earth) {
+          initial_workers.push_back(
+              make_pair(c == 'r' ? Red : Blue, MapLocation(planet, x, y)));
+        } else if (c != '.') {
+          fail(string("unexpected '") + c + "'");
+        }
+      }
+    }
+    karbonite_at[p] = map.m_karbonite;
+  }
+
+  for (const auto &worker : initial_workers) {
+    const auto id = add_unit(worker.first, Worker, worker.second);
+    maps[Earth].m_units.push_back(records[id].unit);
+  }
+}
+
+bool World::is_alive(unsigned id) const {
+  return id < records.size() && records[id].is_alive;
+}
+
+bool World::is_on_map(const MapLocation &loc) const {
+  return maps[loc.get_planet()].is_on_map(loc);
+}
+
+unsigned World::index(const MapLocation &loc) const {
+  return loc.get_x() * maps[loc.get_planet()].m_height + loc.get_y();
+}
+
+bool World::is_passable(const MapLocation &loc) const {
+  return is_on_map(loc) && maps[loc.get_planet()].m_passable[index(loc)];
+}
+
+unsigned World::get_unit_at(const MapLocation &loc) const {
+  return is_on_map(loc) ? unit_at[loc.get_planet()][index(loc)] : 0;
+}
+
+bool World::is_free(const MapLocation &loc) const {
+  return is_passable(loc) && get_unit_at(loc) == 0;
+}
+
+bool World::is_visible(Team team, const MapLocation &loc) const {
+  if (loc.get_planet() != Earth || !is_on_map(loc)) return false;
+  if (is_vision_stale) update_vision();
+  return visible[team][index(loc)];
+}
+
+void World::update_vision() const {
+  const auto &map = maps[Earth];
+  for (auto &cells : visible) cells.assign(map.m_width * map.m_height, false);
+
+  for (const auto &record : records) {
+    if (!record.is_alive) continue;
+    const auto &unit = record.unit;
+    if (!unit.location.is_on_planet(Earth)) continue;
+
+    const auto loc = unit.location.get_map_location();
+    const int range = STATS[unit.unit_type].vision_range;
+    const int radius = sqrt(range);
+    auto &cells = visible[unit.team];
+    for (int dx = -radius; dx <= radius; dx++) {
+      const int x = loc.get_x() + dx;
+      if (x < 0 || x >= (int)map.m_width) continue;
+      for (int dy = -radius; dy <= radius; dy++) {
+        const int y = loc.get_y() + dy;
+        if (y < 0 || y >= (int)map.m_height) continue;
+        if (dx * dx + dy * dy <= range) cells[x * map.m_height + y] = true;
+      }
+    }
+  }
+  is_vision_stale = false;
+}
+
+int World::distance_squared(unsigned id, unsigned other_id) const {
+  if (!is_alive(id) || !is_alive(other_id)) return -1;
+  const auto &a = get(id).location;
+  const auto &b = get(other_id).location;
+  if (!a.is_on_map() || !b.is_on_map()) return -1;
+  const auto a_loc = a.get_map_location();
+  const auto b_loc = b.get_map_location();
+  if (a_loc.get_planet() != b_loc.get_planet()) return -1;
+  return a_loc.distance_squared_to(b_loc);
+}
+
+vector<unsigned> World::get_ids(Team team) const {
+  vector<unsigned> ids;
+  for (unsigned id = 1; id < records.size(); id++) {
+    if (records[id].is_alive && records[id].unit.team == team) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+bool World::has_units(Team team) const {
+  for (const auto &record : records) {
+    if (record.is_alive && record.unit.team == team) return true;
+  }
+  return false;
+}
+
+unsigned World::get_score(Team team) const {
+  unsigned score = 0;
+  for (const auto &record : records) {
+    if (record.is_alive && record.unit.team == team) {
+      score += unit_type_get_value(record.unit.unit_type);
+    }
+  }
+  return score;
+}
+
+// Checks.
+
+bool World::can_move(unsigned id, Direction dir) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  return is_robot(unit.unit_type) && unit.location.is_on_map() &&
+         is_free(unit.location.get_map_location().add(dir));
+}
+
+bool World::is_move_ready(unsigned id) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  return is_robot(unit.unit_type) && unit.movement_heat < constants::MAX_HEAT;
+}
+
+bool World::can_attack(unsigned id, unsigned target_id) const {
+  const auto distance = distance_squared(id, target_id);
+  if (distance == -1) return false;
+  const auto unit_type = get(id).unit_type;
+  if (unit_type == Healer || is_structure(unit_type)) return false;
+  if (unit_type == Ranger &&
+      distance <= (int)constants::RANGER_CANNOT_ATTACK_RANGE) {
+    return false;
+  }
+  return distance <= (int)constants::ATTACK_RANGE[unit_type];
+}
+
+bool World::is_attack_ready(unsigned id) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  return unit.unit_type != Healer && is_robot(unit.unit_type) &&
+         unit.attack_heat < constants::MAX_HEAT;
+}
+
+bool World::can_heal(unsigned id, unsigned target_id) const {
+  const auto distance = distance_squared(id, target_id);
+  if (distance == -1) return false;
+  const auto &unit = get(id);
+  const auto &target = get(target_id);
+  return unit.unit_type == Healer && is_robot(target.unit_type) &&
+         unit.team == target.team &&
+         distance <= (int)constants::ATTACK_RANGE[Healer];
+}
+
+bool World::is_heal_ready(unsigned id) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  return unit.unit_type == Healer && unit.attack_heat < constants::MAX_HEAT;
+}
+
+bool World::can_javelin(unsigned id, unsigned target_id) const {
+  const auto distance = distance_squared(id, target_id);
+  if (distance == -1) return false;
+  const auto &unit = get(id);
+  return unit.unit_type == Knight &&
+         research_level[unit.team][Knight] >= JAVELIN_LEVEL &&
+         distance <= (int)constants::SPECIAL_ATTACK_RANGE[Knight];
+}
+
+bool World::is_javelin_ready(unsigned id) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  return unit.unit_type == Knight &&
+         research_level[unit.team][Knight] >= JAVELIN_LEVEL &&
+         unit.ability_heat < constants::MAX_HEAT;
+}
+
+bool World::can_overcharge(unsigned id, unsigned target_id) const {
+  const auto distance = distance_squared(id, target_id);
+  if (distance == -1) return false;
+  const auto &unit = get(id);
+  const auto &target = get(target_id);
+  return unit.unit_type == Healer &&
+         research_level[unit.team][Healer] >= OVERCHARGE_LEVEL &&
+         is_robot(target.unit_type) && unit.team == target.team &&
+         distance <= (int)constants::SPECIAL_ATTACK_RANGE[Healer];
+}
+
+bool World::is_overcharge_ready(unsigned id) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  return unit.unit_type == Healer &&
+         research_level[unit.team][Healer] >= OVERCHARGE_LEVEL &&
+         unit.ability_heat < constants::MAX_HEAT;
+}
+
+bool World::can_harvest(unsigned id, Direction dir) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  if (unit.unit_type != Worker || unit.has_acted) return false;
+  if (!unit.location.is_on_map()) return false;
+  const auto loc = unit.location.get_map_location().add(dir);
+  return is_on_map(loc) && karbonite_at[loc.get_planet()][index(loc)] > 0;
+}
+
+bool World::can_blueprint(unsigned id, UnitType unit_type,
+                          Direction dir) const {
+  if (!is_alive(id) || !is_structure(unit_type)) return false;
+  const auto &unit = get(id);
+  if (unit.unit_type != Worker || unit.has_acted) return false;
+  if (!unit.location.is_on_planet(Earth)) return false;
+  if (unit_type == Rocket &&
+      research_level[unit.team][Rocket] < ROCKET_LEVEL) {
+    return false;
+  }
+  return karbonite[unit.team] >= BLUEPRINT_COST[unit_type] &&
+         is_free(unit.location.get_map_location().add(dir));
+}
+
+bool World::can_build(unsigned worker_id, unsigned structure_id) const {
+  const auto distance = distance_squared(worker_id, structure_id);
+  if (distance == -1) return false;
+  const auto &worker = get(worker_id);
+  const auto &structure = get(structure_id);
+  return worker.unit_type == Worker && is_structure(structure.unit_type) &&
+         worker.team == structure.team && distance <= 2 &&
+         !worker.has_acted && !structure.is_built;
+}
+
+bool World::can_repair(unsigned worker_id, unsigned structure_id) const {
+  const auto distance = distance_squared(worker_id, structure_id);
+  if (distance == -1) return false;
+  const auto &worker = get(worker_id);
+  const auto &structure = get(structure_id);
+  return worker.unit_type == Worker && is_structure(structure.unit_type) &&
+         worker.team == structure.team && distance <= 2 &&
+         !worker.has_acted && structure.is_built;
+}
+
+bool World::can_replicate(unsigned id, Direction dir) const {
+  if (!is_alive(id)) return false;
+  const auto &unit = get(id);
+  if (unit.unit_type != Worker || unit.has_acted) return false;
+  if (!unit.location.is_on_map()) return false;
+  return karbonite[unit.team] >= REPLICATE_COST &&
+         unit.ability_heat < constants::MAX_HEAT &&
+         is_free(unit.location.get_map_location().add(dir));
+}
+
+bool World::can_load(unsigned structure_id, unsigned robot_id) const {
+  const auto distance = distance_squared(structure_id, robot_id);
+  if (distance == -1) return false;
+  const auto &record = records[structure_id];
+  const auto &structure = record.unit;
+  const auto &robot = get(robot_id);
+  return structure.unit_type == Rocket && structure.is_built &&
+         !record.is_used && is_robot(robot.unit_type) &&
+         structure.team == robot.team &&
+         structure.garrison.size() < GARRISON_CAPACITY && distance <= 2 &&
+         robot.movement_heat < constants::MAX_HEAT;
+}
+
+bool World::can_unload(unsigned structure_id, Direction dir) const {
+  if (!is_alive(structure_id)) return false;
+  const auto &structure = get(structure_id);
+  if (!is_structure(structure.unit_type) || !structure.is_built) return false;
+  if (!structure.location.is_on_map() || structure.garrison.empty()) {
+    return false;
+  }
+  const auto &robot = get(structure.garrison.front());
+  return robot.movement_heat < constants::MAX_HEAT &&
+         is_free(structure.location.get_map_location().add(dir));
+}
+
+bool World::can_produce_robot(unsigned factory_id, UnitType unit_type) const {
+  if (!is_alive(factory_id) || !is_robot(unit_type)) return false;
+  const auto &record = records[factory_id];
+  const auto &factory = record.unit;
+  return factory.unit_type == Factory && factory.is_built &&
+         !record.is_producing &&
+         karbonite[factory.team] >= FACTORY_COST[unit_type];
+}
+
+bool World::can_launch_rocket(unsigned rocket_id,
+                              const MapLocation &loc) const {
+  if (!is_alive(rocket_id)) return false;
+  const auto &record = records[rocket_id];
+  const auto &rocket = record.unit;
+  return rocket.unit_type == Rocket && rocket.is_built && !record.is_used &&
+         rocket.location.is_on_planet(Earth) && loc.get_planet() == Mars &&
+         is_passable(loc);
+}
+
+// Actions.
+
+void World::move(unsigned id, Direction dir) {
+  auto &unit = records[id].unit;
+  const auto loc = unit.location.get_map_location().add(dir);
+  lift(id);
+  place(id, loc);
+  heat_up(unit.movement_heat, STATS[unit.unit_type].movement_cooldown);
+}
+
+void World::attack(unsigned id, unsigned target_id) {
+  auto &unit = records[id].unit;
+  heat_up(unit.attack_heat, STATS[unit.unit_type].attack_cooldown);
+  const auto amount = constants::ATTACK_DAMAGE[unit.unit_type];
+  if (unit.unit_type != Mage) {
+    damage(target_id, amount);
+    return;
+  }
+
+  // Mages hit the cells around their target too, whoever is on them.
+  const auto loc = get(target_id).location.get_map_location();
+  vector<unsigned> hit;
+  for (int i = 0; i < constants::N_DIRECTIONS; i++) {
+    const auto id_at = get_unit_at(loc.add(static_cast<Direction>(i)));
+    if (id_at != 0) hit.push_back(id_at);
+  }
+  for (const auto hit_id : hit) damage(hit_id, amount);
+}
+
+void World::heal(unsigned id, unsigned target_id) {
+  auto &unit = records[id].unit;
+  heat_up(unit.attack_heat, STATS[Healer].attack_cooldown);
+  auto &target = records[target_id].unit;
+  target.health = min(target.max_health, target.health + HEAL_AMOUNT);
+}
+
+void World::javelin(unsigned id, unsigned target_id) {
+  heat_up(records[id].unit.ability_heat, STATS[Knight].ability_cooldown);
+  damage(target_id, constants::ATTACK_DAMAGE[Knight]);
+}
+
+void World::overcharge(unsigned id, unsigned target_id) {
+  heat_up(records[id].unit.ability_heat, STATS[Healer].ability_cooldown);
+  auto &target = records[target_id].unit;
+  target.movement_heat = 0;
+  target.attack_heat = 0;
+  target.ability_heat = 0;
+}
+
+void World::harvest(unsigned id, Direction dir) {
+  auto &unit = records[id].unit;
+  const auto loc = unit.location.get_map_location().add(dir);
+  auto &deposit = karbonite_at[loc.get_planet()][index(loc)];
+  const auto amount =
+      min(deposit, HARVEST_AMOUNT + (research_level[unit.team][Worker] >= 1));
+  deposit -= amount;
+  karbonite[unit.team] += amount;
+  unit.has_acted = true;
+}
+
+unsigned World::blueprint(unsigned id, UnitType unit_type, Direction dir) {
+  auto &unit = records[id].unit;
+  const auto team = unit.team;
+  const auto loc = unit.location.get_map_location().add(dir);
+  unit.has_acted = true;
+  karbonite[team] -= BLUEPRINT_COST[unit_type];
+
+  // `unit` may move as the records grow.
+  const auto structure_id = add_unit(team, unit_type, loc);
+  auto &structure = records[structure_id].unit;
+  structure.health = structure.max_health / 4;
+  structure.is_built = false;
+  return structure_id;
+}
+
+void World::build(unsigned worker_id, unsigned structure_id) {
+  records[worker_id].unit.has_acted = true;
+  auto &structure = records[structure_id].unit;
+  structure.health = min(structure.max_health, structure.health + BUILD_HEALTH);
+  if (structure.health == structure.max_health) structure.is_built = true;
+}
+
+void World::repair(unsigned worker_id, unsigned structure_id) {
+  records[worker_id].unit.has_acted = true;
+  auto &structure = records[structure_id].unit;
+  structure.health =
+      min(structure.max_health, structure.health + REPAIR_HEALTH);
+}
+
+unsigned World::replicate(unsigned id, Direction dir) {
+  auto &unit = records[id].unit;
+  const auto team = unit.team;
+  const auto loc = unit.location.get_map_location().add(dir);
+  unit.has_acted = true;
+  heat_up(unit.ability_heat, STATS[Worker].ability_cooldown);
+  karbonite[team] -= REPLICATE_COST;
+  return add_unit(team, Worker, loc);
+}
+
+void World::load(unsigned structure_id, unsigned robot_id) {
+  auto &robot = records[robot_id].unit;
+  lift(robot_id);
+  robot.location = Location(structure_id);
+  heat_up(robot.movement_heat, STATS[robot.unit_type].movement_cooldown);
+  records[structure_id].unit.garrison.push_back(robot_id);
+}
+
+void World::unload(unsigned structure_id, Direction dir) {
+  auto &structure = records[structure_id].unit;
+  const auto robot_id = structure.garrison.front();
+  structure.garrison.erase(structure.garrison.begin());
+  place(robot_id, structure.location.get_map_location().add(dir));
+  auto &robot = records[robot_id].unit;
+  heat_up(robot.movement_heat, STATS[robot.unit_type].movement_cooldown);
+}
+
+void World::produce_robot(unsigned factory_id, UnitType unit_type) {
+  auto &record = records[factory_id];
+  karbonite[record.unit.team] -= FACTORY_COST[unit_type];
+  record.is_producing = true;
+  record.producing = unit_type;
+  record.rounds_left = FACTORY_ROUNDS;
+}
+
+void World::launch_rocket(unsigned rocket_id, const MapLocation &loc) {
+  auto &record = records[rocket_id];
+  const auto from = record.unit.location.get_map_location();
+  lift(rocket_id);
+  record.unit.location = Location();
+  record.is_used = true;
+  record.landing_round = round + ROCKET_TRAVEL_TIME;
+  record.destination = loc;
+
+  // The blast hurts whoever stayed around.
+  for (int i = 0; i < constants::N_DIRECTIONS_WITHOUT_CENTER; i++) {
+    const auto id = get_unit_at(from.add(static_cast<Direction>(i)));
+    if (id != 0) damage(id, ROCKET_BLAST_DAMAGE);
+  }
+}
+
+void World::disintegrate(unsigned id) { destroy(id); }
+
+bool World::queue_research(Team team, UnitType branch) {
+  unsigned level = research_level[team][branch];
+  for (const auto queued : research_queue[team]) {
+    if (queued == branch) level++;
+  }
+  if (cost_of(branch, level + 1) == numeric_limits<unsigned>::max()) {
+    return false;
+  }
+  research_queue[team].push_back(branch);
+  return true;
+}
+
+// Units.
+
+unsigned World::add_unit(Team team, UnitType unit_type,
+                         const Location &location) {
+  const unsigned id = records.size();
+  records.emplace_back();
+  auto &unit = records.back().unit;
+  unit.id = id;
+  unit.team = team;
+  unit.unit_type = unit_type;
+  unit.health = STATS[unit_type].health;
+  unit.max_health = STATS[unit_type].health;
+  unit.attack_cooldown = STATS[unit_type].attack_cooldown;
+  unit.location = location;
+  if (location.is_on_map()) place(id, location.get_map_location());
+  return id;
+}
+
+void World::place(unsigned id, const MapLocation &loc) {
+  records[id].unit.location = loc;
+  unit_at[loc.get_planet()][index(loc)] = id;
+  is_vision_stale = true;
+}
+
+void World::lift(unsigned id) {
+  const auto &location = records[id].unit.location;
+  if (!location.is_on_map()) return;
+  const auto loc = location.get_map_location();
+  unit_at[loc.get_planet()][index(loc)] = 0;
+  is_vision_stale = true;
+}
+
+void World::damage(unsigned id, unsigned amount) {
+  auto &unit = records[id].unit;
+  if (unit.unit_type == Knight) amount -= min(amount, KNIGHT_DEFENSE);
+  if (unit.health > amount) {
+    unit.health -= amount;
+  } else {
+    destroy(id);
+  }
+}
+
+void World::destroy(unsigned id) {
+  auto &record = records[id];
+  if (!record.is_alive) return;
+  record.is_alive = false;
+  lift(id);
+
+  // What is inside goes down with it.
+  for (const auto robot_id : record.unit.garrison) {
+    records[robot_id].is_alive = false;
+  }
+  record.unit.garrison.clear();
+
+  const auto &location = record.unit.location;
+  if (location.is_in_garrison()) {
+    auto &garrison = records[location.get_structure()].unit.garrison;
+    garrison.erase(find(garrison.begin(), garrison.end(), id));
+  }
+}
+
+void World::heat_up(unsigned &heat, unsigned cooldown) { heat += cooldown; }
+
+// Rounds.
+
+bool World::end_round() {
+  play_opponent();
+
+  for (unsigned id = 1; id < records.size(); id++) {
+    auto &record = records[id];
+    if (!record.is_alive) continue;
+    auto &unit = record.unit;
+    unit.movement_heat -= min(unit.movement_heat, constants::MAX_HEAT);
+    unit.attack_heat -= min(unit.attack_heat, constants::MAX_HEAT);
+    unit.ability_heat -= min(unit.ability_heat, constants::MAX_HEAT);
+    unit.has_acted = false;
+
+    // Whatever sits where a rocket lands is crushed.
+    if (record.is_used && record.landing_round == round) {
+      const auto crushed = get_unit_at(record.destination);
+      if (crushed != 0) destroy(crushed);
+      place(id, record.destination);
+    }
+
+    // Robots wait in the factory when it is full.
+    if (record.is_producing) {
+      if (record.rounds_left > 0) record.rounds_left--;
+      if (record.rounds_left == 0 &&
+          unit.garrison.size() < GARRISON_CAPACITY) {
+        const auto team = unit.team;
+        const auto unit_type = record.producing;
+        record.is_producing = false;
+        // Invalidates `record` and `unit`.
+        const auto robot_id = add_unit(team, unit_type, Location(id));
+        records[id].unit.garrison.push_back(robot_id);
+      }
+    }
+  }
+
+  for (int t = 0; t < 2; t++) {
+    auto &queue = research_queue[t];
+    if (!queue.empty()) {
+      const auto branch = queue.front();
+      auto &level = research_level[t][branch];
+      if (++research_progress[t] >= cost_of(branch, level + 1)) {
+        level++;
+        research_progress[t] = 0;
+        queue.pop_front();
+      }
+    }
+
+    const auto decrease = karbonite[t] / KARBONITE_DECREASE_DIVISOR;
+    karbonite[t] += KARBONITE_PER_ROUND - min(KARBONITE_PER_ROUND, decrease);
+  }
+
+  round++;
+
+  // Earth floods, and takes everything on it.
+  if (round == constants::FLOOD_ROUND) {
+    for (unsigned id = 1; id < records.size(); id++) {
+      if (records[id].is_alive &&
+          records[id].unit.location.is_on_planet(Earth)) {
+        destroy(id);
+      }
+    }
+  }
+
+  for (const auto team : {Red, Blue}) {
+    if (eliminated_round[team] == 0 && !has_units(team)) {
+      eliminated_round[team] = round - 1;
+    }
+  }
+  return round <= constants::N_ROUNDS;
+}
+
+}  // namespace sim
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bc.hpp"
+
+namespace sim {
+
+using namespace bc;
+
+// The state of a game and its rules, for both teams. The actions assume
+// their check passed; GameController and the opponent check first.
+//
+// Kept to what the bot relies on: one Earth game with vision, heat, the
+// karbonite income, structures, production, research levels, the flood and
+// rockets. Rockets that reach Mars only sit there, nobody plays Mars.
+struct World {
+  struct Record {
+    Unit unit;
+    bool is_alive = true;
+    // Factories.
+    bool is_producing = false;
+    UnitType producing = Worker;
+    unsigned rounds_left = 0;
+    // Rockets.
+    bool is_used = false;
+    unsigned landing_round = 0;
+    MapLocation destination;
+  };
+
+  constexpr static unsigned ROCKET_TRAVEL_TIME = 50;
+  constexpr static unsigned STARTING_KARBONITE = 100;
+  constexpr static unsigned N_RESEARCH_BRANCHES = 8;
+
+  uint32_t round = 1;
+  std::array<unsigned, 2> karbonite;
+  std::array<PlanetMap, 2> maps;
+
+  // Per planet, indexed by [x * height + y]. Cells without a unit hold 0.
+  std::array<std::vector<unsigned>, 2> karbonite_at;
+  std::array<std::vector<unsigned>, 2> unit_at;
+
+  // Indexed by id, starting at 1. Dead units keep their record.
+  std::vector<Record> records;
+
+  // Per team.
+  std::array<std::array<unsigned, N_RESEARCH_BRANCHES>, 2> research_level;
+  std::array<std::deque<UnitType>, 2> research_queue;
+  std::array<unsigned, 2> research_progress;
+
+  // Last round each team had units on, or 0 while it still has. Unlike the
+  // engine, the game goes on to the last round regardless, so that every
+  // game is as long to profile.
+  std::array<unsigned, 2> eliminated_round;
+
+  std::mt19937 rng;
+
+  // Errors of invalid actions, which the engine would log.
+  unsigned n_errors = 0;
+
+  // Time the bot took on its turns, against the engine's time pool.
+  std::chrono::steady_clock::time_point turn_start;
+  double time_pool_ms = 10000;
+  double total_turn_ms = 0;
+  double max_turn_ms = 0;
+  unsigned n_timeouts = 0;
+  // Time spent in end_round().
+  double simulation_ms = 0;
+
+  explicit World(const std::string& map_path, unsigned seed);
+
+  // Ends the round: the opponent plays, then heat, production, research,
+  // income, rockets and the flood. Returns whether there is another round.
+  bool end_round();
+  // Whether `team` has a unit left anywhere.
+  bool has_units(Team team) const;
+  // Total value of the units of `team`, which breaks ties at the end.
+  unsigned get_score(Team team) const;
+
+  // Lookups.
+  bool is_alive(unsigned id) const;
+  const Unit& get(unsigned id) const { return records[id].unit; }
+  bool is_on_map(const MapLocation& loc) const;
+  unsigned index(const MapLocation& loc) const;
+  bool is_passable(const MapLocation& loc) const;
+  // Id of the unit on `loc`, or 0.
+  unsigned get_unit_at(const MapLocation& loc) const;
+  bool is_free(const MapLocation& loc) const;
+  bool is_visible(Team team, const MapLocation& loc) const;
+  // Squared distance between two units on the same map, or -1.
+  int distance_squared(unsigned id, unsigned other_id) const;
+  std::vector<unsigned> get_ids(Team team) const;
+
+  // Checks, the engine's rules for the unit's own team.
+  bool can_move(unsigned id, Direction dir) const;
+  bool is_move_ready(unsigned id) const;
+  bool can_attack(unsigned id, unsigned target_id) const;
+  bool is_attack_ready(unsigned id) const;
+  bool can_heal(unsigned id, unsigned target_id) const;
+  bool is_heal_ready(unsigned id) const;
+  bool can_javelin(unsigned id, unsigned target_id) const;
+  bool is_javelin_ready(unsigned id) const;
+  bool can_overcharge(unsigned id, unsigned target_id) const;
+  bool is_overcharge_ready(unsigned id) const;
+  bool can_harvest(unsigned id, Direction dir) const;
+  bool can_blueprint(unsigned id, UnitType unit_type, Direction dir) const;
+  bool can_build(unsigned worker_id, unsigned structure_id) const;
+  bool can_repair(unsigned worker_id, unsigned structure_id) const;
+  bool can_replicate(unsigned id, Direction dir) const;
+  bool can_load(unsigned structure_id, unsigned robot_id) const;
+  bool can_unload(unsigned structure_id, Direction dir) const;
+  bool can_produce_robot(unsigned factory_id, UnitType unit_type) const;
+  bool can_launch_rocket(unsigned rocket_id, const MapLocation& loc) const;
+
+  // Actions.
+  void move(unsigned id, Direction dir);
+  void attack(unsigned id, unsigned target_id);
+  void heal(unsigned id, unsigned target_id);
+  void javelin(unsigned id, unsigned target_id);
+  void overcharge(unsigned id, unsigned target_id);
+  void harvest(unsigned id, Direction dir);
+  unsigned blueprint(unsigned id, UnitType unit_type, Direction dir);
+  void build(unsigned worker_id, unsigned structure_id);
+  void repair(unsigned worker_id, unsigned structure_id);
+  unsigned replicate(unsigned id, Direction dir);
+  void load(unsigned structure_id, unsigned robot_id);
+  void unload(unsigned structure_id, Direction dir);
+  void produce_robot(unsigned factory_id, UnitType unit_type);
+  void launch_rocket(unsigned rocket_id, const MapLocation& loc);
+  void disintegrate(unsigned id);
+  bool queue_research(Team team, UnitType branch);
+
+  // The scripted Blue team, in Opponent.cpp. It sees the whole map.
+  void play_opponent();
+
+ private:
+  unsigned add_unit(Team team, UnitType unit_type, const Location& location);
+  void place(unsigned id, const MapLocation& loc);
+  void lift(unsigned id);
+  void damage(unsigned id, unsigned amount);
+  void destroy(unsigned id);
+  void heat_up(unsigned& heat, unsigned cooldown);
+
+  void load_map(const std::string& map_path);
+  void update_vision() const;
+
+  // Moves the opponent's unit closer to `goal`, or anywhere when stuck.
+  bool step_towards(unsigned id, const MapLocation& goal);
+
+  // Cells each team sees on Earth, rebuilt when a unit comes or goes.
+  mutable std::array<std::vector<bool>, 2> visible;
+  mutable bool is_vision_stale = true;
+};
+
+}  // namespace sim
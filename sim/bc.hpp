@@ -0,0 +1,338 @@
+/*
+ * Stand-in for external/bc.hpp, for headless builds.
+ *
+ * Implements the part of the C++ API the bot uses on top of World, an
+ * in-process game, instead of the engine and its manager. `make headless`
+ * puts this directory first on the include path.
+ */
+
+#pragma once
+
+#include <climits>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#ifndef MAX_ROUNDS
+#define MAX_ROUNDS 1000
+#endif
+
+// Global, like the enums of bc.h.
+typedef enum { Earth, Mars } bc_Planet;
+typedef enum { Red, Blue } bc_Team;
+typedef enum {
+  Worker,
+  Knight,
+  Ranger,
+  Mage,
+  Healer,
+  Factory,
+  Rocket
+} bc_UnitType;
+typedef enum {
+  North,
+  Northeast,
+  East,
+  Southeast,
+  South,
+  Southwest,
+  West,
+  Northwest,
+  Center
+} bc_Direction;
+
+// Research cost of a level, in rounds.
+unsigned cost_of(bc_UnitType branch, unsigned level);
+
+namespace sim {
+struct World;
+}
+
+namespace bc {
+
+using Planet = bc_Planet;
+using Team = bc_Team;
+using UnitType = bc_UnitType;
+using Direction = bc_Direction;
+
+inline int direction_dx(Direction direction) {
+  static const int dx[] = {0, 1, 1, 1, 0, -1, -1, -1, 0};
+  return dx[direction];
+}
+
+inline int direction_dy(Direction direction) {
+  static const int dy[] = {1, 1, 0, -1, -1, -1, 0, 1, 0};
+  return dy[direction];
+}
+
+class MapLocation {
+ public:
+  MapLocation() : m_planet{Earth}, m_x{0}, m_y{0} {}
+  MapLocation(Planet planet, int x, int y)
+      : m_planet{planet}, m_x{x}, m_y{y} {}
+
+  Planet get_planet() const { return m_planet; }
+  int get_x() const { return m_x; }
+  int get_y() const { return m_y; }
+
+  MapLocation add(Direction direction) const {
+    return MapLocation(m_planet, m_x + direction_dx(direction),
+                       m_y + direction_dy(direction));
+  }
+
+  unsigned distance_squared_to(const MapLocation& map_location) const {
+    if (m_planet != map_location.get_planet()) return INT_MAX;
+    int dx = m_x - map_location.get_x();
+    int dy = m_y - map_location.get_y();
+    return dx * dx + dy * dy;
+  }
+
+  bool operator==(const MapLocation& map_location) const {
+    return (map_location.get_planet() == m_planet and
+            map_location.get_x() == m_x and map_location.get_y() == m_y);
+  }
+  bool operator!=(const MapLocation& map_location) const {
+    return !((*this) == map_location);
+  }
+
+ private:
+  Planet m_planet;
+  int m_x;
+  int m_y;
+};
+
+class Location {
+ public:
+  Location() : m_type{Space} {}
+  Location(const MapLocation& map_location)
+      : m_type{Map}, m_map_location{map_location} {}
+  Location(unsigned garrison_id)
+      : m_type{Garrison}, m_garrison_id{garrison_id} {}
+
+  bool is_on_map() const { return m_type == Map; }
+  bool is_on_planet(Planet planet) const {
+    return (m_type == Map and m_map_location.get_planet() == planet);
+  }
+  MapLocation get_map_location() const { return m_map_location; }
+
+  bool is_in_garrison() const { return m_type == Garrison; }
+  int get_structure() const { return m_garrison_id; }
+
+  bool is_in_space() const { return m_type == Space; }
+
+ private:
+  enum { Map, Garrison, Space } m_type;
+
+  unsigned m_garrison_id = 0;
+  MapLocation m_map_location;
+};
+
+inline bool is_structure(UnitType unit_type) {
+  return unit_type == Factory or unit_type == Rocket;
+}
+inline bool is_robot(UnitType unit_type) { return !is_structure(unit_type); }
+
+unsigned unit_type_get_factory_cost(UnitType unit_type);
+unsigned unit_type_get_blueprint_cost(UnitType unit_type);
+unsigned unit_type_get_replicate_cost();
+unsigned unit_type_get_value(UnitType unit_type);
+
+// A copy of a unit as it was when asked for, like the engine's.
+class Unit {
+ public:
+  UnitType get_unit_type() const { return unit_type; }
+  unsigned get_id() const { return id; }
+  Team get_team() const { return team; }
+  Location get_location() const { return location; }
+  bool is_on_map() const { return location.is_on_map(); }
+  MapLocation get_map_location() const {
+    return location.get_map_location();
+  }
+
+  unsigned get_health() const { return health; }
+  unsigned get_max_health() const { return max_health; }
+
+  unsigned get_movement_heat() const { return movement_heat; }
+  unsigned get_attack_heat() const { return attack_heat; }
+  unsigned get_attack_cooldown() const { return attack_cooldown; }
+  unsigned get_ability_heat() const { return ability_heat; }
+  bool worker_has_acted() const { return has_acted; }
+
+  bool structure_is_built() const { return is_built; }
+  std::vector<unsigned> get_structure_garrison() const { return garrison; }
+
+  bool is_structure() const { return bc::is_structure(unit_type); }
+  bool is_robot() const { return !is_structure(); }
+
+ private:
+  friend struct sim::World;
+
+  UnitType unit_type = Worker;
+  unsigned id = 0;
+  Team team = Red;
+  Location location;
+  unsigned health = 0;
+  unsigned max_health = 0;
+  unsigned movement_heat = 0;
+  unsigned attack_heat = 0;
+  unsigned attack_cooldown = 0;
+  unsigned ability_heat = 0;
+  bool has_acted = false;
+  bool is_built = true;
+  std::vector<unsigned> garrison;
+};
+
+class PlanetMap {
+ public:
+  Planet get_planet() const { return m_planet; }
+  unsigned get_width() const { return m_width; }
+  unsigned get_height() const { return m_height; }
+
+  bool is_on_map(const MapLocation& map_location) const {
+    return map_location.get_planet() == m_planet and
+           map_location.get_x() >= 0 and
+           map_location.get_x() < (int)m_width and
+           map_location.get_y() >= 0 and map_location.get_y() < (int)m_height;
+  }
+  bool is_passable_terrain_at(const MapLocation& map_location) const {
+    return m_passable[index(map_location)];
+  }
+  unsigned get_initial_karbonite_at(const MapLocation& map_location) const {
+    return m_karbonite[index(map_location)];
+  }
+  const std::vector<Unit>& get_initial_units() const { return m_units; }
+
+ private:
+  friend struct sim::World;
+
+  unsigned index(const MapLocation& map_location) const {
+    return map_location.get_x() * m_height + map_location.get_y();
+  }
+
+  Planet m_planet = Earth;
+  unsigned m_width = 0;
+  unsigned m_height = 0;
+  // Indexed by [x * height + y].
+  std::vector<bool> m_passable;
+  std::vector<unsigned> m_karbonite;
+  std::vector<Unit> m_units;
+};
+
+class AsteroidStrike {
+ public:
+  AsteroidStrike(unsigned karbonite, const MapLocation& map_location)
+      : m_karbonite{karbonite}, m_map_location{map_location} {}
+
+  unsigned get_karbonite() const { return m_karbonite; }
+  MapLocation get_map_location() const { return m_map_location; }
+
+ private:
+  unsigned m_karbonite;
+  MapLocation m_map_location;
+};
+
+// No asteroids fall in the simulator: only Earth is played.
+class AsteroidPattern {
+ public:
+  bool has_asteroid_on_round(unsigned) const { return false; }
+  AsteroidStrike get_asteroid_on_round(unsigned) const {
+    return AsteroidStrike(0, MapLocation(Mars, 0, 0));
+  }
+};
+
+// Plays Red on Earth against a scripted Blue. The map is read from the file
+// named by $BC_MAP. next_turn() plays the rest of the round, and exits the
+// program with a summary once the game is over.
+class GameController {
+ public:
+  GameController();
+  ~GameController();
+
+  GameController(const GameController& that) = delete;
+  GameController& operator=(const GameController& that) = delete;
+
+  void next_turn() const;
+  unsigned get_round() const;
+  Planet get_planet() const;
+  Team get_team() const;
+
+  const PlanetMap& get_starting_planet(Planet planet);
+
+  unsigned get_karbonite() const;
+  unsigned get_time_left_ms() const;
+
+  bool has_unit(unsigned id) const;
+  Unit get_unit(unsigned id) const;
+  std::vector<Unit> get_units() const;
+
+  unsigned get_karbonite_at(const MapLocation& map_location) const;
+  bool can_sense_location(const MapLocation& map_location) const;
+  bool has_unit_at_location(const MapLocation& map_location) const;
+  Unit sense_unit_at_location(const MapLocation& map_location) const;
+
+  const AsteroidPattern& get_asteroid_pattern() const {
+    return m_asteroid_pattern;
+  }
+
+  void disintegrate_unit(unsigned id) const;
+
+  bool can_move(unsigned id, Direction direction) const;
+  bool is_move_ready(unsigned id) const;
+  void move_robot(unsigned id, Direction direction) const;
+
+  bool can_attack(unsigned id, unsigned target_id) const;
+  bool is_attack_ready(unsigned id) const;
+  void attack(unsigned id, unsigned target_id) const;
+
+  bool queue_research(UnitType branch) const;
+
+  bool can_harvest(unsigned id, Direction direction) const;
+  void harvest(unsigned id, Direction direction) const;
+
+  bool can_blueprint(unsigned id, UnitType unit_type,
+                     Direction direction) const;
+  void blueprint(unsigned id, UnitType unit_type, Direction direction) const;
+
+  bool can_build(unsigned worker_id, unsigned blueprint_id) const;
+  void build(unsigned worker_id, unsigned blueprint_id) const;
+
+  bool can_repair(unsigned worker_id, unsigned structure_id) const;
+  void repair(unsigned worker_id, unsigned structure_id) const;
+
+  bool can_replicate(unsigned worker_id, Direction direction) const;
+  void replicate(unsigned worker_id, Direction direction) const;
+
+  bool can_javelin(unsigned knight_id, unsigned target_id) const;
+  bool is_javelin_ready(unsigned knight_id) const;
+  void javelin(unsigned knight_id, unsigned target_id) const;
+
+  bool can_heal(unsigned healer_id, unsigned target_id) const;
+  bool is_heal_ready(unsigned healer_id) const;
+  void heal(unsigned healer_id, unsigned target_id) const;
+
+  bool can_overcharge(unsigned healer_id, unsigned target_id) const;
+  bool is_overcharge_ready(unsigned healer_id) const;
+  void overcharge(unsigned healer_id, unsigned target_id) const;
+
+  bool can_load(unsigned structure_id, unsigned robot_id) const;
+  void load(unsigned structure_id, unsigned robot_id) const;
+
+  bool can_unload(unsigned structure_id, Direction direction) const;
+  void unload(unsigned structure_id, Direction direction) const;
+
+  bool can_produce_robot(unsigned factory_id, UnitType unit_type) const;
+  void produce_robot(unsigned factory_id, UnitType unit_type) const;
+
+  bool can_launch_rocket(unsigned rocket_id,
+                         const MapLocation& map_location) const;
+  void launch_rocket(unsigned rocket_id,
+                     const MapLocation& map_location) const;
+
+ private:
+  bool is_mine(unsigned id) const;
+
+  std::unique_ptr<sim::World> m_world;
+  AsteroidPattern m_asteroid_pattern;
+};
+
+}  // namespace bc
@@ -0,0 +1,36 @@
+#!/bin/bash
+#
+# Plays seeds 1 to N of the headless build, one game per core at a time, and
+# prints every summary in seed order followed by the number of Red wins.
+#
+#   make headless && sim/play_games.sh [N] [JOBS]
+#
+# BC_MAP picks the map, as for a single game.
+#
+
+set -e
+
+N_GAMES="${1:-16}"
+JOBS="${2:-$(nproc)}"
+AGENT="./build/headless/agent"
+
+if [[ ! -x "${AGENT}" ]]; then
+  echo "${AGENT} is missing, run make headless first" >&2
+  exit 1
+fi
+
+# Summaries go to one file per game, so that games running at the same time
+# don't interleave their lines.
+LOG_DIR="$(mktemp -d)"
+trap 'rm -rf "${LOG_DIR}"' EXIT
+
+seq 1 "${N_GAMES}" |
+  xargs -P "${JOBS}" -I {} \
+    sh -c "BC_SEED={} '${AGENT}' > /dev/null 2> '${LOG_DIR}/{}.log'"
+
+for seed in $(seq 1 "${N_GAMES}"); do
+  echo "Seed ${seed}:"
+  cat "${LOG_DIR}/${seed}.log"
+done
+N_WINS="$(grep -l 'Red wins' "${LOG_DIR}"/*.log | wc -l)"
+echo "Red won ${N_WINS} of ${N_GAMES} games"
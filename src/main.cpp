@@ -1,6 +1,11 @@
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "GameState.hpp"
 #include "MapInfo.hpp"
@@ -18,6 +23,13 @@ using namespace bc;
 const static int MIN_WORKER_COUNT = 8;
 const static int MIN_FACTORY_COUNT = 2;
 
+// Where distance tables are shared between games on the same map, under
+// the user's cache directory.
+const static char *DISTANCE_CACHE_NAME = "bc18-distances";
+
+// Memory budget of the goal field cache of lazy distance tables.
+const static size_t DISTANCE_CACHE_BUDGET = 4 << 20;
+
 // Defines distribution of unit types in percentages.
 // Should at most add up to 1.
 const static array<double, constants::N_UNIT_TYPES> target_distribution = {{
@@ -33,15 +45,14 @@ const static array<double, constants::N_UNIT_TYPES> target_distribution = {{
 bool waiting_to_build_rocket = false;
 
 bool is_being_built(const GameState &game_state, UnitType unit_type) {
-  for (const auto unit_id : game_state.my_units.by_type[unit_type]) {
-    const auto unit = game_state.gc.get_unit(unit_id);
-    if (!unit.structure_is_built()) return true;
+  for (const auto unit_id : game_state.my_units.of_type(unit_type)) {
+    if (!game_state.get_unit(unit_id).is_built) return true;
   }
   return false;
 }
 
 UnitType which_to_build(const GameState &game_state) {
-  const auto worker_count = game_state.my_units.by_type[Worker].size();
+  const auto worker_count = game_state.my_units.count(Worker);
   if (waiting_to_build_rocket && worker_count >= 1) {
     return Rocket;
   }
@@ -58,19 +69,18 @@ UnitType which_to_build(const GameState &game_state) {
   }
 
   if (!is_being_built(game_state, Factory)) {
-    const auto factory_count = game_state.my_units.by_type[Factory].size();
+    const auto factory_count = game_state.my_units.count(Factory);
     if (factory_count < MIN_FACTORY_COUNT) {
       return Factory;
     }
   }
 
   double sum = 0;
-  const double unit_count = game_state.my_units.all.size();
+  const double unit_count = game_state.my_units.size();
   array<double, constants::N_UNIT_TYPES> current_distribution_error{};
   for (int i = 0; i < constants::N_UNIT_TYPES; i++) {
-    const auto error =
-        max(0.00, target_distribution[i] -
-                      game_state.my_units.by_type[i].size() / unit_count);
+    const auto count = game_state.my_units.count(static_cast<UnitType>(i));
+    const auto error = max(0.00, target_distribution[i] - count / unit_count);
     current_distribution_error[i] = error;
     sum += error;
   }
@@ -89,6 +99,24 @@ UnitType which_to_build(const GameState &game_state) {
   return Worker;
 }
 
+// $DISTANCE_CACHE_DIR, or the user's own cache directory, never a directory
+// shared with other users.
+string get_distance_cache_dir() {
+  const auto dir = getenv("DISTANCE_CACHE_DIR");
+  if (dir != nullptr) return dir;
+  const auto cache_home = getenv("XDG_CACHE_HOME");
+  if (cache_home != nullptr && cache_home[0] == '/') {
+    return string(cache_home) + "/" + DISTANCE_CACHE_NAME;
+  }
+  const auto home = getenv("HOME");
+  if (home != nullptr && home[0] == '/') {
+    const auto default_cache_home = string(home) + "/.cache";
+    mkdir(default_cache_home.c_str(), 0700);
+    return default_cache_home + "/" + DISTANCE_CACHE_NAME;
+  }
+  return "/tmp/" + string(DISTANCE_CACHE_NAME) + "-" + to_string(geteuid());
+}
+
 int main() {
   cout << "Bot starting..." << endl;
 
@@ -111,14 +139,35 @@ int main() {
 
   const auto start_s = clock();
 
-  PairwiseDistances worker_distances(game_state.map_info.passable_terrain,
+  // One movement table, every core pitching in, over half the goals on
+  // symmetric maps. The attack tables are views of it. On Mars only the few
+  // units that landed move, so only the goals they ask for are computed,
+  // and DISTANCE_CACHE_BUDGET set to a number of bytes does the same on
+  // Earth.
+  PairwiseDistances::Config movement_distances_config;
+  movement_distances_config.compact = true;
+  movement_distances_config.n_threads = 0;
+  movement_distances_config.symmetry = game_state.map_info.symmetry;
+  const auto distance_cache_budget = getenv("DISTANCE_CACHE_BUDGET");
+  if (distance_cache_budget != nullptr) {
+    movement_distances_config.cache_budget = atol(distance_cache_budget);
+  } else if (game_state.PLANET == Mars) {
+    movement_distances_config.cache_budget = DISTANCE_CACHE_BUDGET;
+  }
+  movement_distances_config.cache_dir = get_distance_cache_dir();
+
+  PairwiseDistances movement_distances(game_state.map_info.passable_terrain,
+                                       constants::POINT_KERNEL,
+                                       movement_distances_config);
+  game_state.add_distance_listener(movement_distances);
+  PairwiseDistances worker_distances(movement_distances,
                                      constants::KERNEL[Worker]);
-  PairwiseDistances ranger_attack_distances(
-      game_state.map_info.passable_terrain, constants::KERNEL[Ranger]);
+  PairwiseDistances ranger_attack_distances(movement_distances,
+                                            constants::KERNEL[Ranger]);
 
   // XXX: this is only ok because they have the same specs.
-  PairwiseDistances mage_or_healer_distances(
-      game_state.map_info.passable_terrain, constants::KERNEL[Mage]);
+  PairwiseDistances mage_or_healer_distances(movement_distances,
+                                             constants::KERNEL[Mage]);
 
   // Strategies.
   WorkerRushStrategy worker_rush(worker_distances);
@@ -146,6 +195,8 @@ int main() {
   cout << "Analyzing map took "
        << (stop_s - start_s) / double(CLOCKS_PER_SEC) * 1000 << " milliseconds"
        << endl;
+  cout << "Distance tables use " << movement_distances.memory_usage() / 1024
+       << " KiB" << endl;
 
   // First thing get some research going
   if (game_state.PLANET == Earth) {
@@ -197,8 +248,8 @@ int main() {
           const auto unit_type = which_to_build(game_state);
           switch (unit_type) {
             case Worker:
-              if (game_state.my_units.by_type[Worker].size() < 3 ||
-                  game_state.my_units.by_type[Factory].size() == 0) {
+              if (game_state.my_units.count(Worker) < 3 ||
+                  game_state.my_units.count(Factory) == 0) {
                 // Favor creating workers by replicating because faster.
                 worker_rush.set_should_replicate(true);
                 break;
@@ -211,16 +262,16 @@ int main() {
             case Mage:
             case Healer:
               is_successful = build[unit_type]->run(
-                  game_state, game_state.my_units.by_type[Factory]);
+                  game_state, game_state.my_units.get_ids(Factory));
               break;
             case Rocket:
               is_successful = build[unit_type]->run(
-                  game_state, game_state.my_units.by_type[Worker]);
+                  game_state, game_state.my_units.get_ids(Worker));
               if (is_successful) waiting_to_build_rocket = false;
               break;
             case Factory:
               is_successful = build[unit_type]->run(
-                  game_state, game_state.my_units.by_type[Worker]);
+                  game_state, game_state.my_units.get_ids(Worker));
               break;
           }
         }
@@ -228,31 +279,40 @@ int main() {
         // Try to build factory anyway to not waste karbonite.
         if (!is_being_built(game_state, Factory) &&
             which_to_build(game_state) != Rocket) {
-          build[Factory]->run(game_state, game_state.my_units.by_type[Worker]);
+          build[Factory]->run(game_state, game_state.my_units.get_ids(Worker));
         }
 
-        board_rockets.run(game_state, game_state.my_units.all);
-        unboard.run(game_state, game_state.my_units.by_type[Factory]);
+        board_rockets.run(game_state, game_state.my_units.get_ids());
+        unboard.run(game_state, game_state.my_units.get_ids(Factory));
       } break;
       case Mars:
-        unboard.run(game_state, game_state.my_units.by_type[Rocket]);
+        unboard.run(game_state, game_state.my_units.get_ids(Rocket));
         break;
     }
 
     // Do this twice because might have overcharged.
     for (int i = 0; i < 2; i++) {
-      worker_rush.run(game_state, game_state.my_units.by_type[Worker]);
+      worker_rush.run(game_state, game_state.my_units.get_ids(Worker));
       for (int i = 0; i < constants::N_ROBOT_TYPES; i++) {
         const auto unit_type = static_cast<UnitType>(i);
         attack[unit_type]->run(game_state,
-                               game_state.my_units.by_type[unit_type]);
+                               game_state.my_units.get_ids(unit_type));
       }
     }
 
-    launch_rockets.run(game_state, game_state.my_units.by_type[Rocket]);
+    launch_rockets.run(game_state, game_state.my_units.get_ids(Rocket));
 
-    cout << "My unit count: " << game_state.my_units.by_id.size() << endl;
-    cout << "Enemy unit count: " << game_state.enemy_units.by_id.size() << endl;
+    cout << "My unit count: " << game_state.my_units.size() << endl;
+    cout << "Enemy unit count: " << game_state.enemy_units.size() << endl;
+    if (movement_distances.lazy) {
+      cout << "Distance cache hits/misses: " << movement_distances.cache_hits
+           << "/" << movement_distances.cache_misses << endl;
+    }
+#ifdef CHECK_DISTANCES
+    cout << "Distance repair mismatches: "
+         << movement_distances.repair_mismatches << ", recomputed fields: "
+         << movement_distances.n_recomputed_fields << endl;
+#endif
 
     const auto stop_s = clock();
     cout << "Round took " << (stop_s - start_s) / double(CLOCKS_PER_SEC) * 1000